@@ -0,0 +1,492 @@
+// Micro-benchmarks for the hot paths, run with 'angry-pixel-sim -B <name>'
+// Times are host nanoseconds, so only the ratios carry over to the target
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hal.h"
+#include "display.h"
+#include "canvas.h"
+#include "game.h"
+#include "levels.h"
+
+#include "bitmaps/lvl.c"
+#include "bitmaps/cleared.c"
+#include "bitmaps/digits.c"
+#include "bitmaps/next.c"
+
+// Stands in for the GPIO data register, so that the loops below can't be optimized away
+static volatile uint8_t gpio_sink;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Returns the average time per call of 'fn', in ns
+static double bench_time(void (*fn)(), uint32_t iterations) {
+    // Warm up
+    fn();
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    return (double) (now_ns() - start) / iterations;
+}
+
+static void fill_random(uint8_t *buffer, size_t size) {
+    srand(1);
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = rand();
+    }
+}
+
+/*
+ * scan: encoding and shifting out a frame
+ */
+
+// Scan passes per game frame
+#define SCANS_PER_FRAME (DISPLAY_REFRESH_RATE / REFRESH_RATE)
+
+static uint8_t scan_frame[DISPLAY_BPP][DISPLAY_HEIGHT][DISPLAY_WIDTH / 8];
+static uint32_t scan_tx[DISPLAY_BPP][DISPLAY_HEIGHT][DISPLAY_WIDTH / 32];
+
+// The per-bit loop the display used to run for every line of every pass
+static void scan_per_bit() {
+    for (int pass = 0; pass < SCANS_PER_FRAME; pass++) {
+        for (int plane = 0; plane < DISPLAY_BPP; plane++) {
+            for (int line = 0; line < DISPLAY_HEIGHT; line++) {
+                for (int byte_index = 0; byte_index < DISPLAY_WIDTH / 8; byte_index++) {
+                    uint8_t data = scan_frame[plane][line][byte_index];
+
+                    for (int i = 0; i < 8; i++) {
+                        gpio_sink = !(data & 0x1) ? DISPLAY_PIN_DATA : 0;
+                        gpio_sink = DISPLAY_PIN_SHIFT;
+                        gpio_sink = 0;
+                        data >>= 1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// What the SSI backend used to do for every line of every pass
+static void scan_per_line_reverse() {
+    static const uint8_t reverse_nibble[16] = {
+        0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
+    };
+
+    for (int pass = 0; pass < SCANS_PER_FRAME; pass++) {
+        for (int plane = 0; plane < DISPLAY_BPP; plane++) {
+            for (int line = 0; line < DISPLAY_HEIGHT; line++) {
+                for (int byte_index = 0; byte_index < DISPLAY_WIDTH / 8; byte_index++) {
+                    uint8_t inverted = ~scan_frame[plane][line][byte_index];
+                    gpio_sink = reverse_nibble[inverted & 0xf] << 4 | reverse_nibble[inverted >> 4];
+                }
+            }
+        }
+    }
+}
+
+// Encoding once per frame, like display_flip() does, then streaming words
+static void scan_encoded_gpio() {
+    const uint32_t *pixels = (const uint32_t *) scan_frame;
+    uint32_t *tx = scan_tx[0][0];
+    for (int i = 0; i < DISPLAY_BPP * DISPLAY_HEIGHT * (DISPLAY_WIDTH / 32); i++) {
+        tx[i] = ~pixels[i];
+    }
+
+    for (int pass = 0; pass < SCANS_PER_FRAME; pass++) {
+        for (int plane = 0; plane < DISPLAY_BPP; plane++) {
+            for (int line = 0; line < DISPLAY_HEIGHT; line++) {
+                for (int word_index = 0; word_index < DISPLAY_WIDTH / 32; word_index++) {
+                    uint32_t data = scan_tx[plane][line][word_index];
+
+                    for (int i = 0; i < 32; i++) {
+                        gpio_sink = (data & 0x1) ? DISPLAY_PIN_DATA : 0;
+                        gpio_sink = DISPLAY_PIN_SHIFT;
+                        gpio_sink = 0;
+                        data >>= 1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void scan_encoded_ssi() {
+    const uint32_t *pixels = (const uint32_t *) scan_frame;
+    uint32_t *tx = scan_tx[0][0];
+    for (int i = 0; i < DISPLAY_BPP * DISPLAY_HEIGHT * (DISPLAY_WIDTH / 32); i++) {
+        tx[i] = hal_rev(hal_rbit(~pixels[i]));
+    }
+    // The uDMA takes it from here
+}
+
+// The real thing, including the buffer swap
+static void scan_display_flip() {
+    display_flip(DISPLAY_ROWS_ALL);
+}
+
+// What a frame with a flying pixel typically changes
+static void scan_display_flip_2_rows() {
+    display_flip(0x0180);
+}
+
+static void bench_scan() {
+    fill_random((uint8_t *) scan_frame, sizeof(scan_frame));
+
+    printf("  %d bpp, %d scan passes per game frame, per game frame:\n", DISPLAY_BPP, SCANS_PER_FRAME);
+    printf("  GPIO, per-bit extraction on every pass: %10.0f ns\n", bench_time(scan_per_bit, 1000));
+    printf("  GPIO, encoded once, words streamed:     %10.0f ns\n", bench_time(scan_encoded_gpio, 1000));
+    printf("  SSI, bytes reversed on every pass:      %10.0f ns\n", bench_time(scan_per_line_reverse, 1000));
+    printf("  SSI, encoded once with RBIT/REV:        %10.0f ns\n", bench_time(scan_encoded_ssi, 1000));
+    printf("  display_flip() (encode + swap):         %10.0f ns\n", bench_time(scan_display_flip, 1000));
+    printf("  display_flip(), 2 rows changed:         %10.0f ns\n", bench_time(scan_display_flip_2_rows, 1000));
+}
+
+/*
+ * canvas: drawing primitives
+ */
+
+// Drawing pixel by pixel, the way the primitives used to
+static void canvas_rects_per_pixel() {
+    for (int i = 0; i < 16; i++) {
+        for (int y = i - 4; y <= i + 4; y++) {
+            for (int x = 4 * i - 8; x <= 4 * i + 8; x++) {
+                canvas_pixel_set(x, y);
+            }
+        }
+    }
+}
+
+static void canvas_rects_fill() {
+    for (int i = 0; i < 16; i++) {
+        canvas_rect_fill(4 * i - 8, i - 4, 4 * i + 8, i + 4);
+    }
+}
+
+static void canvas_rects_stroke() {
+    for (int i = 0; i < 16; i++) {
+        canvas_rect_stroke(4 * i - 8, i - 4, 4 * i + 8, i + 4);
+    }
+}
+
+static void canvas_hlines() {
+    for (int i = 0; i < 16; i++) {
+        canvas_hline(i, 63 - i, i);
+    }
+}
+
+static void canvas_world() {
+    // Roughly what a full world grid looks like
+    for (int row = 0; row < 5; row++) {
+        for (int col = 0; col < 10; col++) {
+            int x = 32 + 3 * col;
+            int y = 3 * row;
+            if ((row + col) % 2) {
+                canvas_rect_fill(x, 15 - y, x + 2, 15 - (y + 2));
+            } else {
+                canvas_rect_stroke(x, 15 - y, x + 2, 15 - (y + 2));
+            }
+        }
+    }
+}
+
+// Float-stepped lines, clipped pixel by pixel
+static void canvas_float_line(float x1, float y1, float x2, float y2) {
+    float dx = x2 - x1, dy = y2 - y1;
+    float steps = dx * dx > dy * dy ? (dx < 0 ? -dx : dx) : (dy < 0 ? -dy : dy);
+    float x = x1, y = y1;
+
+    for (float i = 0; i <= steps; i++) {
+        canvas_pixel_set((int) (x + 0.5f), (int) (y + 0.5f));
+        x += dx / steps;
+        y += dy / steps;
+    }
+}
+
+// Float distance test for every pixel in the bounding box
+static void canvas_float_circle(float cx, float cy, float r, bool fill) {
+    for (float y = cy - r; y <= cy + r; y++) {
+        for (float x = cx - r; x <= cx + r; x++) {
+            float d = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+            if (d <= r * r + r && (fill || d >= r * r - r)) {
+                canvas_pixel_set(x, y);
+            }
+        }
+    }
+}
+
+// A fan of aim vectors, partly off the canvas
+static void canvas_lines_float() {
+    for (int i = 0; i < 16; i++) {
+        canvas_float_line(4, 12, 4 + 4 * i, 12 - 16 + 2 * i);
+    }
+}
+
+static void canvas_lines() {
+    for (int i = 0; i < 16; i++) {
+        canvas_line(4, 12, 4 + 4 * i, 12 - 16 + 2 * i);
+    }
+}
+
+// Targets of growing size along the canvas, the larger ones clipped
+static void canvas_circles_float_fill() {
+    for (int i = 0; i < 8; i++) {
+        canvas_float_circle(8 * i + 4, 8, i + 1, true);
+    }
+}
+
+static void canvas_circles_float_stroke() {
+    for (int i = 0; i < 8; i++) {
+        canvas_float_circle(8 * i + 4, 8, i + 1, false);
+    }
+}
+
+static void canvas_circles_fill() {
+    for (int i = 0; i < 8; i++) {
+        canvas_circle_fill(8 * i + 4, 8, i + 1);
+    }
+}
+
+static void canvas_circles_stroke() {
+    for (int i = 0; i < 8; i++) {
+        canvas_circle_stroke(8 * i + 4, 8, i + 1);
+    }
+}
+
+static void bench_canvas() {
+    printf("  16 clipped 17x9 rects, pixel by pixel: %8.0f ns\n", bench_time(canvas_rects_per_pixel, 10000));
+    printf("  16 clipped 17x9 rects, filled:         %8.0f ns\n", bench_time(canvas_rects_fill, 10000));
+    printf("  16 clipped 17x9 rects, stroked:        %8.0f ns\n", bench_time(canvas_rects_stroke, 10000));
+    printf("  16 hlines:                             %8.0f ns\n", bench_time(canvas_hlines, 10000));
+    printf("  50 grid cells:                         %8.0f ns\n", bench_time(canvas_world, 10000));
+    printf("  canvas_clear():                        %8.0f ns\n", bench_time(canvas_clear, 10000));
+    printf("  16 clipped lines, float per pixel:     %8.0f ns\n", bench_time(canvas_lines_float, 10000));
+    printf("  16 clipped lines, Bresenham:           %8.0f ns\n", bench_time(canvas_lines, 10000));
+    printf("  8 filled circles, float per pixel:     %8.0f ns\n", bench_time(canvas_circles_float_fill, 10000));
+    printf("  8 filled circles, midpoint spans:      %8.0f ns\n", bench_time(canvas_circles_fill, 10000));
+    printf("  8 circle outlines, float per pixel:    %8.0f ns\n", bench_time(canvas_circles_float_stroke, 10000));
+    printf("  8 circle outlines, midpoint:           %8.0f ns\n", bench_time(canvas_circles_stroke, 10000));
+}
+
+/*
+ * blit: drawing bitmaps
+ */
+
+// The way canvas_bitmap() used to work
+static void bitmap_per_pixel(int offset_x, int offset_y, const uint8_t *bitmap, int w, int h) {
+    int bytes_per_row = (w + 7) / 8;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (bitmap[y * bytes_per_row + x / 8] & (1 << (7 - (x % 8)))) {
+                canvas_pixel_set(offset_x + x, offset_y + y);
+            } else {
+                canvas_pixel_clear(offset_x + x, offset_y + y);
+            }
+        }
+    }
+}
+
+// What the 'CLEARED!' screen draws
+static void blit_won_screen_per_pixel() {
+    bitmap_per_pixel(2, 2, bitmap_lvl, bitmap_lvl_width, bitmap_lvl_height);
+    bitmap_per_pixel(15, 2, digit_bitmaps[4], digit_bitmap_width, digit_bitmap_height);
+    bitmap_per_pixel(20, 2, bitmap_cleared, bitmap_cleared_width, bitmap_cleared_height);
+    bitmap_per_pixel(6, 9, digit_bitmaps[3], digit_bitmap_width, digit_bitmap_height);
+    bitmap_per_pixel(55, 7, bitmap_next, bitmap_next_width, bitmap_next_height);
+}
+
+static void blit_won_screen() {
+    canvas_bitmap(2, 2, bitmap_lvl, bitmap_lvl_width, bitmap_lvl_height);
+    canvas_bitmap(15, 2, digit_bitmaps[4], digit_bitmap_width, digit_bitmap_height);
+    canvas_bitmap(20, 2, bitmap_cleared, bitmap_cleared_width, bitmap_cleared_height);
+    canvas_bitmap(6, 9, digit_bitmaps[3], digit_bitmap_width, digit_bitmap_height);
+    canvas_bitmap(55, 7, bitmap_next, bitmap_next_width, bitmap_next_height);
+}
+
+static void bench_blit() {
+    printf("  'CLEARED!' screen, pixel by pixel: %8.0f ns\n", bench_time(blit_won_screen_per_pixel, 10000));
+    printf("  'CLEARED!' screen, blitted:        %8.0f ns\n", bench_time(blit_won_screen, 10000));
+}
+
+/*
+ * render: drawing game frames
+ */
+
+static uint32_t render_frame[CANVAS_BUFFER_SIZE / 4];
+
+// Holds 'input' down for 'frames' frames, pressed on the first one
+static void render_play(uint32_t input, int frames) {
+    for (int i = 0; i < frames; i++) {
+        game_tick(input, i == 0 ? input : 0, 1);
+    }
+}
+
+// Everything drawn from scratch, like every frame used to be
+static void render_redrawn() {
+    game_invalidate();
+    game_render();
+}
+
+static void render_composited() {
+    game_render();
+}
+
+// A frame of a result screen that is already on the display
+static void render_unchanged() {
+    game_tick(0, 0, 1);
+}
+
+static void bench_render() {
+    canvas_set_buffer((uint8_t *) render_frame);
+    game_init();
+
+    // Past the input delay, aiming at the first level
+    render_play(0, REFRESH_RATE);
+    printf("  aiming, redrawn:           %8.0f ns\n", bench_time(render_redrawn, 10000));
+    printf("  aiming, composited:        %8.0f ns\n", bench_time(render_composited, 10000));
+
+    // Throw and let it fly for a bit
+    render_play(BUTTON_PIN_THROW, 1);
+    render_play(0, REFRESH_RATE / 3);
+    printf("  pixel flying, redrawn:     %8.0f ns\n", bench_time(render_redrawn, 10000));
+    printf("  pixel flying, composited:  %8.0f ns\n", bench_time(render_composited, 10000));
+
+    // Keep throwing until the level is over, game_tick() stops drawing once the result screen is up
+    bool drawn = true;
+    while (drawn) {
+        render_play(BUTTON_PIN_THROW, 1);
+        for (int i = 0; i < 3 * REFRESH_RATE && drawn; i++) {
+            drawn = game_tick(0, 0, 1);
+        }
+    }
+    printf("  result screen, redrawn:    %8.0f ns\n", bench_time(render_redrawn, 10000));
+    printf("  result screen, unchanged:  %8.0f ns\n", bench_time(render_unchanged, 10000));
+}
+
+/*
+ * levels: loading a level into the world grid
+ */
+
+// How levels used to be stored: a list of objects, 12 bytes each on the target
+enum object_type {
+    OBJECT_TYPE_END = 0,
+    OBJECT_TYPE_SOLID,
+    OBJECT_TYPE_BOX,
+    OBJECT_TYPE_TARGET
+};
+
+struct object {
+    enum object_type type;
+    size_t col;
+    size_t row;
+};
+
+// Level 3 (see src/levels/03.txt), the one with the most objects
+static const struct object level3_objects[] = {
+    { OBJECT_TYPE_BOX, 2, 0 },
+    { OBJECT_TYPE_BOX, 2, 1 },
+    { OBJECT_TYPE_BOX, 2, 2 },
+    { OBJECT_TYPE_BOX, 3, 0 },
+    { OBJECT_TYPE_TARGET, 3, 1 },
+    { OBJECT_TYPE_SOLID, 4, 2 },
+    { OBJECT_TYPE_SOLID, 4, 3 },
+    { OBJECT_TYPE_TARGET, 4, 4 },
+    { OBJECT_TYPE_SOLID, 8, 0 },
+    { OBJECT_TYPE_SOLID, 8, 1 },
+    { OBJECT_TYPE_SOLID, 8, 2 },
+    { OBJECT_TYPE_TARGET, 9, 0 },
+    { OBJECT_TYPE_END, 0, 0 }
+};
+
+static uint16_t level_solid[LEVEL_ROWS];
+static uint16_t level_box[LEVEL_ROWS];
+static uint16_t level_target[LEVEL_ROWS];
+
+// Clearing the grid and setting one cell per object, like load_level() used to
+static void levels_objects() {
+    memset(level_solid, 0, sizeof(level_solid));
+    memset(level_box, 0, sizeof(level_box));
+    memset(level_target, 0, sizeof(level_target));
+
+    for (const struct object *object = level3_objects; object->type != OBJECT_TYPE_END; object++) {
+        uint16_t bit = 1 << object->col;
+        level_solid[object->row] &= ~bit;
+        level_box[object->row] &= ~bit;
+        level_target[object->row] &= ~bit;
+
+        switch (object->type) {
+            case OBJECT_TYPE_SOLID: level_solid[object->row] |= bit; break;
+            case OBJECT_TYPE_BOX: level_box[object->row] |= bit; break;
+            case OBJECT_TYPE_TARGET: level_target[object->row] |= bit; break;
+            default: break;
+        }
+    }
+}
+
+static void levels_packed() {
+    level_unpack(&levels[3], level_solid, level_box, level_target);
+}
+
+static void bench_levels() {
+    // Flash per level on the target: the objects and their terminator, plus the level's pixels and pointer
+    size_t objects = sizeof(level3_objects) / sizeof(*level3_objects);
+    printf("  object list:  %3zu bytes  %8.1f ns\n", objects * 12 + 8, bench_time(levels_objects, 1000000));
+    printf("  packed:       %3zu bytes  %8.1f ns\n", sizeof(struct level), bench_time(levels_packed, 1000000));
+
+    // Both have to come out the same
+    uint16_t solid[LEVEL_ROWS], box[LEVEL_ROWS], target[LEVEL_ROWS];
+    levels_objects();
+    memcpy(solid, level_solid, sizeof(solid));
+    memcpy(box, level_box, sizeof(box));
+    memcpy(target, level_target, sizeof(target));
+    levels_packed();
+    if (memcmp(solid, level_solid, sizeof(solid)) != 0 || memcmp(box, level_box, sizeof(box)) != 0 ||
+            memcmp(target, level_target, sizeof(target)) != 0) {
+        printf("  packed level differs from the object list!\n");
+    }
+}
+
+static const struct {
+    const char *name;
+    const char *description;
+    void (*run)();
+} benches[] = {
+    { "scan", "Encoding and shifting out the frame buffer", bench_scan },
+    { "canvas", "Drawing primitives", bench_canvas },
+    { "blit", "Drawing bitmaps", bench_blit },
+    { "render", "Drawing game frames", bench_render },
+    { "levels", "Loading a level", bench_levels },
+};
+
+bool bench_run(const char *name) {
+    bool found = false;
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(*benches); i++) {
+        if (strcmp(name, "all") == 0 || strcmp(name, benches[i].name) == 0) {
+            printf("%s: %s\n", benches[i].name, benches[i].description);
+            benches[i].run();
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void bench_list() {
+    for (size_t i = 0; i < sizeof(benches) / sizeof(*benches); i++) {
+        fprintf(stderr, "  %-12s %s\n", benches[i].name, benches[i].description);
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdbool.h>
+
+// Runs the benchmark called 'name' ("all" runs all of them), returns false if there is no such benchmark
+bool bench_run(const char *name);
+void bench_list();
+
+#endif /* __BENCH_H__ */
@@ -0,0 +1,363 @@
+#include "hal.h"
+#include "hal_sim.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Model of the LED panel, driven by the pin writes of display.c
+// The first bit shifted into a line ends up left-most, a low 'DATA' level turns the LED on, a high 'ENABLE'
+// level turns all LEDs off.
+// The scan runs on a virtual clock (in hal_cycles() units), which is used to work out how long each LED is lit.
+
+static uint8_t pin_levels;
+static uint64_t shift_register;
+// Latched by the last 'LATCH' pulse, shown on the selected line
+static uint64_t output_register;
+static uint64_t display_writes;
+// Bits shifted in since the last latch
+static uint32_t shifted_bits;
+static FILE *bitstream_file;
+
+static uint32_t buttons;
+static void (*buttons_changed)();
+static void (*buttons_settled)();
+// Virtual time until the debounce timer runs out, 0 if it isn't running
+static uint64_t settle_time_left;
+
+static void (*uart_transfer_done)();
+static FILE *uart_file;
+// Virtual time until the UART transfer is done, 0 if there is none
+static uint64_t uart_time_left;
+
+// What stands in for the other end of the UART, -1 if nothing does
+static int uart_fd = -1;
+static void (*uart_received)(const uint8_t *data, uint32_t size);
+static uint8_t *uart_receive_buffers[2];
+static uint32_t uart_receive_size;
+static uint8_t uart_receive_index;
+static uint32_t uart_receive_length;
+// Read from 'uart_fd' and not received yet, and the virtual time since the last byte was received
+static uint8_t uart_pending[256];
+static uint32_t uart_pending_start, uart_pending_end;
+static uint64_t uart_receive_time;
+
+static void (*scan_timer_slot)();
+// Length of the running slot and the reload value for the next one
+static uint32_t slot_period;
+static uint32_t next_slot_period;
+// Virtual time that is left to run
+static uint64_t scan_time_left;
+// Set by hal_display_blank_after() for the running slot, 0 if 'ENABLE' stays as it is
+static uint32_t blank_after;
+
+// How long each line was selected and how long each LED was lit since sim_panel_reset()
+static uint64_t selected_time[DISPLAY_HEIGHT];
+static uint64_t lit_time[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+
+static void panel_shift(bool data) {
+    shift_register = (shift_register >> 1) | ((uint64_t) data << 63);
+    shifted_bits++;
+}
+
+void hal_init() {
+}
+
+void hal_display_init() {
+    hal_display_write(DISPLAY_PINS, 0x00);
+}
+
+void hal_display_write(uint8_t pins, uint8_t data) {
+    uint8_t rising = ~pin_levels & data & pins;
+
+    pin_levels = (pin_levels & ~pins) | (data & pins);
+
+    display_writes++;
+
+    if (rising & DISPLAY_PIN_SHIFT) {
+        panel_shift((pin_levels & DISPLAY_PIN_DATA) != 0);
+    }
+
+    if (rising & DISPLAY_PIN_LATCH) {
+        uint8_t line = (pin_levels & DISPLAY_LINE_PINS) >> 4;
+
+        output_register = ~shift_register;
+
+        if (bitstream_file != NULL) {
+            fprintf(bitstream_file, "%2u %3u %016llx\n", line, shifted_bits, (unsigned long long) shift_register);
+        }
+        shifted_bits = 0;
+    }
+}
+
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+
+static void sim_ssi_run();
+
+// Register model of the SSI transmit path and the uDMA channel feeding it
+
+#define SSI_FIFO_SIZE 8
+
+static struct {
+    void (*transfer_done)();
+
+    // uDMA channel: source pointer, remaining items and enable bit
+    const uint8_t *dma_src;
+    uint32_t dma_remaining;
+    bool dma_enabled;
+
+    // SSI transmit FIFO
+    uint8_t fifo[SSI_FIFO_SIZE];
+    uint8_t fifo_count;
+} ssi;
+
+void hal_ssi_init(void (*transfer_done)()) {
+    ssi.transfer_done = transfer_done;
+}
+
+void hal_ssi_transfer(const uint8_t *data, uint32_t size) {
+    ssi.dma_src = data;
+    ssi.dma_remaining = size;
+    ssi.dma_enabled = true;
+}
+
+// Runs the SSI and its uDMA channel until they are idle
+static void sim_ssi_run() {
+    while (ssi.dma_enabled || ssi.fifo_count > 0) {
+        // The uDMA keeps the FIFO filled
+        while (ssi.dma_enabled && ssi.fifo_count < SSI_FIFO_SIZE) {
+            ssi.fifo[ssi.fifo_count++] = *ssi.dma_src++;
+            if (--ssi.dma_remaining == 0) {
+                ssi.dma_enabled = false;
+            }
+        }
+
+        // Shift out the oldest byte, MSB first, one clock pulse per bit
+        uint8_t data = ssi.fifo[0];
+        ssi.fifo_count--;
+        for (uint8_t i = 0; i < ssi.fifo_count; i++) {
+            ssi.fifo[i] = ssi.fifo[i + 1];
+        }
+
+        for (uint8_t i = 0; i < 8; i++) {
+            panel_shift(data & 0x80);
+            data <<= 1;
+        }
+
+        // End of transmission
+        if (!ssi.dma_enabled && ssi.fifo_count == 0) {
+            ssi.transfer_done();
+        }
+    }
+}
+
+#endif
+
+void hal_scan_timer_init(uint32_t period, void (*slot)()) {
+    scan_timer_slot = slot;
+    slot_period = period;
+    next_slot_period = period;
+}
+
+void hal_scan_timer_next(uint32_t period) {
+    next_slot_period = period;
+}
+
+void hal_display_blank_after(uint32_t cycles) {
+    blank_after = cycles;
+}
+
+void hal_buttons_init(void (*changed)(), void (*settled)()) {
+    buttons_changed = changed;
+    buttons_settled = settled;
+}
+
+void hal_buttons_settle_after(uint32_t cycles) {
+    settle_time_left = cycles;
+}
+
+void hal_uart_init(void (*transfer_done)()) {
+    uart_transfer_done = transfer_done;
+}
+
+void hal_uart_transfer(const uint8_t *data, uint32_t size) {
+    if (uart_file != NULL) {
+        fwrite(data, 1, size, uart_file);
+    }
+    if (uart_fd >= 0) {
+        // Nobody listening, or not fast enough: like on a real serial port, what doesn't get through is gone
+        ssize_t written = write(uart_fd, data, size);
+        (void) written;
+    }
+    // Takes as long as the bits take on the wire
+    uart_time_left = (uint64_t) size * 10 * HAL_CYCLES_PER_SECOND / TELEMETRY_UART_BAUD;
+}
+
+static void uart_receive_swap() {
+    const uint8_t *data = uart_receive_buffers[uart_receive_index];
+    uint32_t size = uart_receive_length;
+    uart_receive_index ^= 1;
+    uart_receive_length = 0;
+
+    uart_received(data, size);
+}
+
+void hal_uart_receive_init(uint8_t *buffer0, uint8_t *buffer1, uint32_t size,
+        void (*received)(const uint8_t *data, uint32_t size)) {
+    uart_received = received;
+    uart_receive_buffers[0] = buffer0;
+    uart_receive_buffers[1] = buffer1;
+    uart_receive_size = size;
+}
+
+void hal_uart_receive_flush() {
+    if (uart_receive_length > 0) {
+        uart_receive_swap();
+    }
+}
+
+// Receives what the other end sent, as fast as the baud rate allows in 'elapsed' virtual time
+static void uart_receive(uint64_t elapsed) {
+    const uint64_t byte_time = (uint64_t) 10 * HAL_CYCLES_PER_SECOND / TELEMETRY_UART_BAUD;
+
+    uart_receive_time += elapsed;
+    while (uart_receive_time >= byte_time) {
+        if (uart_pending_start == uart_pending_end) {
+            ssize_t size = read(uart_fd, uart_pending, sizeof(uart_pending));
+            if (size <= 0) {
+                // The line is idle, the next byte can't come in before a byte time from now
+                uart_receive_time = 0;
+                return;
+            }
+            uart_pending_start = 0;
+            uart_pending_end = size;
+        }
+
+        uart_receive_time -= byte_time;
+        uart_receive_buffers[uart_receive_index][uart_receive_length++] = uart_pending[uart_pending_start++];
+        if (uart_receive_length == uart_receive_size) {
+            uart_receive_swap();
+        }
+    }
+}
+
+uint32_t hal_buttons_read() {
+    return buttons;
+}
+
+bool hal_interrupts_disable() {
+    // The simulator is single-threaded
+    return true;
+}
+
+void hal_interrupts_restore(bool was_disabled) {
+}
+
+void hal_wait_for_interrupt() {
+}
+
+uint32_t hal_cycles() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) ((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+void sim_buttons_set(uint32_t buttons_) {
+    // The simulated buttons don't bounce, all changes come in as a single edge
+    bool changed = buttons_ != buttons;
+    buttons = buttons_;
+    if (changed && buttons_changed != NULL) {
+        buttons_changed();
+    }
+}
+
+void sim_panel_reset() {
+    memset(selected_time, 0, sizeof(selected_time));
+    memset(lit_time, 0, sizeof(lit_time));
+}
+
+void sim_panel_levels(uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (int x = 0; x < DISPLAY_WIDTH; x++) {
+            levels[y][x] = selected_time[y] > 0 ? lit_time[y][x] * 255 / selected_time[y] : 0;
+        }
+    }
+}
+
+uint64_t sim_display_writes() {
+    return display_writes;
+}
+
+// Counts down a one-shot timer that is running if 'time_left' isn't 0, returns true when it runs out
+static bool one_shot_elapsed(uint64_t *time_left, uint64_t elapsed) {
+    if (*time_left == 0) {
+        return false;
+    }
+    if (*time_left > elapsed) {
+        *time_left -= elapsed;
+        return false;
+    }
+    *time_left = 0;
+    return true;
+}
+
+void sim_scan_for(uint64_t duration) {
+    scan_time_left += duration;
+
+    while (scan_time_left >= slot_period) {
+        scan_time_left -= slot_period;
+
+        // Account for the slot that is ending
+        uint8_t line = (pin_levels & DISPLAY_LINE_PINS) >> 4;
+        uint32_t lit = 0;
+        if (!(pin_levels & DISPLAY_PIN_ENABLE)) {
+            lit = (blank_after > 0 && blank_after < slot_period) ? blank_after : slot_period;
+        }
+        if (blank_after > 0) {
+            pin_levels |= DISPLAY_PIN_ENABLE;
+            blank_after = 0;
+        }
+
+        selected_time[line] += slot_period;
+        for (int x = 0; x < DISPLAY_WIDTH; x++) {
+            if ((output_register >> x) & 1) {
+                lit_time[line][x] += lit;
+            }
+        }
+
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+        // Let the SSI finish whatever was started in the previous slot
+        sim_ssi_run();
+#endif
+
+        // The debounce timer and the UART, to the nearest slot
+        if (one_shot_elapsed(&settle_time_left, slot_period)) {
+            buttons_settled();
+        }
+        if (one_shot_elapsed(&uart_time_left, slot_period)) {
+            uart_transfer_done();
+        }
+        if (uart_fd >= 0 && uart_received != NULL) {
+            uart_receive(slot_period);
+        }
+
+        // The timer reloads and fires
+        slot_period = next_slot_period;
+        scan_timer_slot();
+    }
+}
+
+void sim_uart_record(FILE *f) {
+    uart_file = f;
+}
+
+void sim_uart_connect(int fd) {
+    uart_fd = fd;
+}
+
+void sim_bitstream_record(FILE *f) {
+    bitstream_file = f;
+}
@@ -0,0 +1,36 @@
+#ifndef __HAL_SIM_H__
+#define __HAL_SIM_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "display.h"
+
+// Simulator side of the HAL: lets the simulator press buttons and look at the LED panel
+
+// Sets the buttons that are pressed, as a combination of BUTTON_PIN_*, with an edge interrupt if they changed
+void sim_buttons_set(uint32_t buttons);
+
+// Starts measuring how bright each LED is
+void sim_panel_reset();
+// How bright each LED was on average since sim_panel_reset(), 0 (off) to 255 (lit all the time its line was selected)
+void sim_panel_levels(uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]);
+
+// Advances the virtual clock of the display scan by 'duration' hal_cycles(), firing the scan timer (and the
+// debounce timer) as it goes
+void sim_scan_for(uint64_t duration);
+
+// Number of hal_display_write() calls so far
+uint64_t sim_display_writes();
+
+// Writes every latched line to 'f': line number, bits shifted since the previous latch and the
+// raw shift register contents. Identical for all display backends.
+void sim_bitstream_record(FILE *f);
+
+// Writes everything sent on the telemetry UART to 'f'
+void sim_uart_record(FILE *f);
+// Connects the other end of the telemetry UART to 'fd', which has to be non-blocking: what is sent is written to
+// it, and what can be read from it is received
+void sim_uart_connect(int fd);
+
+#endif /* __HAL_SIM_H__ */
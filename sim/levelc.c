@@ -0,0 +1,183 @@
+// Level compiler
+// Turns ASCII level files into src/levels.c, in the packed format of src/levels.h. Run as
+// 'angry-pixel-levelc <file>... > levels.c', the levels come out in the order of the files. With '-p <pack>' it
+// writes a level pack instead, for angry-pixel-levelserve to send to the board: the level packets of
+// src/loader.h, one after the other.
+//
+// A level file is a 'pixels <n>' line with the number of pixels the player gets, then the grid as LEVEL_ROWS lines
+// of LEVEL_COLS characters, the top row first: '.' for an empty cell, '#' for a solid one, 'B' for a box and 'T'
+// for a target. Lines starting with ';' are comments.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "levels.h"
+#include "loader.h"
+
+static bool cell_from_char(char c, enum level_cell *cell) {
+    switch (c) {
+        case '.': *cell = LEVEL_CELL_EMPTY; return true;
+        case '#': *cell = LEVEL_CELL_SOLID; return true;
+        case 'B': *cell = LEVEL_CELL_BOX; return true;
+        case 'T': *cell = LEVEL_CELL_TARGET; return true;
+        default: return false;
+    }
+}
+
+// Reads the level file at 'path' into 'level', or says what is wrong with it on stderr and returns false
+static bool compile_level(const char *path, struct level *level) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    memset(level, 0, sizeof(*level));
+
+    int pixels = -1;
+    int rows = 0;
+    int line_number = 0;
+    bool ok = true;
+
+    char line[128];
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == ';' || line[0] == '\0') {
+            continue;
+        }
+
+        if (pixels < 0) {
+            if (sscanf(line, "pixels %d", &pixels) != 1 || pixels < 1 || pixels > UINT8_MAX) {
+                fprintf(stderr, "%s:%d: expected 'pixels <1 to %d>'\n", path, line_number, UINT8_MAX);
+                ok = false;
+            }
+            level->pixels = pixels;
+            continue;
+        }
+
+        if (rows == LEVEL_ROWS || strlen(line) != LEVEL_COLS) {
+            fprintf(stderr, "%s:%d: expected %d rows of %d cells\n", path, line_number, LEVEL_ROWS, LEVEL_COLS);
+            ok = false;
+            continue;
+        }
+
+        // The top row comes first
+        int row = LEVEL_ROWS - 1 - rows;
+        for (int col = 0; col < LEVEL_COLS && ok; col++) {
+            enum level_cell cell;
+            if (!cell_from_char(line[col], &cell)) {
+                fprintf(stderr, "%s:%d: unknown cell '%c'\n", path, line_number, line[col]);
+                ok = false;
+                continue;
+            }
+
+            int bit = row * LEVEL_COLS + col;
+            for (int plane = 0; plane < 2; plane++) {
+                if (cell & (1 << plane)) {
+                    level->planes[plane][bit / 8] |= 1 << (bit % 8);
+                }
+            }
+        }
+        rows++;
+    }
+
+    fclose(f);
+
+    if (ok && rows != LEVEL_ROWS) {
+        fprintf(stderr, "%s: expected %d rows of %d cells, got %d\n", path, LEVEL_ROWS, LEVEL_COLS, rows);
+        ok = false;
+    }
+
+    return ok;
+}
+
+static void print_plane(const uint8_t plane[LEVEL_PLANE_SIZE]) {
+    printf("{ ");
+    for (int i = 0; i < LEVEL_PLANE_SIZE; i++) {
+        printf("0x%02x%s", plane[i], i < LEVEL_PLANE_SIZE - 1 ? ", " : " ");
+    }
+    printf("}");
+}
+
+static bool write_pack(const char *path, const struct level *compiled, int level_total) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    for (int i = 0; i < level_total; i++) {
+        uint8_t packet[LOADER_PACKET_SIZE];
+        packet[0] = LOADER_SYNC;
+        packet[1] = LOADER_PACKET_LEVEL;
+        packet[2] = i;
+        packet[3] = i >> 8;
+        packet[4] = level_total;
+        packet[5] = level_total >> 8;
+        packet[6] = compiled[i].pixels;
+        memcpy(packet + 7, compiled[i].planes, sizeof(compiled[i].planes));
+        uint16_t crc = loader_crc(packet + 1, LOADER_PACKET_SIZE - 3);
+        packet[LOADER_PACKET_SIZE - 2] = crc;
+        packet[LOADER_PACKET_SIZE - 1] = crc >> 8;
+
+        fwrite(packet, 1, sizeof(packet), f);
+    }
+
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *pack_path = NULL;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+        pack_path = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Usage: %s <level file>... > levels.c\n", argv[0]);
+        fprintf(stderr, "       %s -p <pack> <level file>...\n", argv[0]);
+        return 1;
+    }
+
+    int level_total = argc - first;
+    struct level *compiled = calloc(level_total, sizeof(*compiled));
+    for (int i = 0; i < level_total; i++) {
+        if (!compile_level(argv[first + i], &compiled[i])) {
+            return 1;
+        }
+    }
+
+    if (pack_path != NULL) {
+        bool ok = write_pack(pack_path, compiled, level_total);
+        free(compiled);
+        return ok ? 0 : 1;
+    }
+
+    printf("// Generated by sim/levelc.c from the files in src/levels/, edit those instead\n");
+    printf("\n");
+    printf("#include \"levels.h\"\n");
+    printf("\n");
+    printf("const struct level levels[] = {\n");
+    for (int i = 0; i < level_total; i++) {
+        // Just the file name, so that the output doesn't depend on where it's run from
+        const char *name = strrchr(argv[first + i], '/');
+        printf("    // %s\n", name != NULL ? name + 1 : argv[first + i]);
+        printf("    { %d, { ", compiled[i].pixels);
+        print_plane(compiled[i].planes[0]);
+        printf(", ");
+        print_plane(compiled[i].planes[1]);
+        printf(" } },\n");
+    }
+    printf("};\n");
+    printf("\n");
+    printf("const size_t level_count = sizeof(levels) / sizeof(*levels);\n");
+
+    free(compiled);
+
+    return 0;
+}
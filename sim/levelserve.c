@@ -0,0 +1,155 @@
+// Level server
+// Answers the board's level requests with the levels of a pack made by 'angry-pixel-levelc -p', over the board's
+// serial port or the pseudo-terminal of 'angry-pixel-sim -u'. Run as 'angry-pixel-levelserve <pack> <device>'.
+// Everything else the board sends is skipped, so telemetry can't be viewed at the same time.
+
+// For cfmakeraw()
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#include "hal.h"
+#include "loader.h"
+#include "telemetry.h"
+
+static uint8_t *pack;
+static int pack_levels;
+
+// Reads the pack at 'path', returns false if it can't be read or any packet in it is damaged
+static bool load_pack(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    uint8_t packet[LOADER_PACKET_SIZE];
+    while (fread(packet, 1, sizeof(packet), f) == sizeof(packet)) {
+        uint16_t crc = packet[LOADER_PACKET_SIZE - 2] | packet[LOADER_PACKET_SIZE - 1] << 8;
+        int index = packet[2] | packet[3] << 8;
+        if (packet[0] != LOADER_SYNC || packet[1] != LOADER_PACKET_LEVEL || index != pack_levels ||
+                loader_crc(packet + 1, LOADER_PACKET_SIZE - 3) != crc) {
+            fprintf(stderr, "%s: level %d is damaged\n", path, pack_levels);
+            fclose(f);
+            return false;
+        }
+
+        pack = realloc(pack, (pack_levels + 1) * LOADER_PACKET_SIZE);
+        memcpy(pack + pack_levels * LOADER_PACKET_SIZE, packet, sizeof(packet));
+        pack_levels++;
+    }
+    fclose(f);
+
+    if (pack_levels == 0) {
+        fprintf(stderr, "%s: no levels\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Opens the serial port at 'path', raw and at the board's baud rate if it is one
+static int open_device(const char *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B460800);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static void send_level(int fd, int index) {
+    if (index >= pack_levels) {
+        fprintf(stderr, "level %d requested, the pack has %d\n", index, pack_levels);
+        return;
+    }
+
+    if (write(fd, pack + index * LOADER_PACKET_SIZE, LOADER_PACKET_SIZE) != LOADER_PACKET_SIZE) {
+        perror("write");
+        return;
+    }
+    fprintf(stderr, "level %d sent\n", index);
+}
+
+// The telemetry packet being read: sync, type, length (2 bytes), payload, checksum. None is bigger than the board's
+// transmit buffer.
+static uint8_t packet[TELEMETRY_BUFFER_SIZE];
+static uint32_t packet_length;
+
+static void receive_byte(int fd, uint8_t byte) {
+    if (packet_length == 0 && byte != TELEMETRY_SYNC) {
+        return;
+    }
+    packet[packet_length++] = byte;
+    if (packet_length < 4) {
+        return;
+    }
+
+    uint32_t payload_length = packet[2] | packet[3] << 8;
+    bool damaged = 4 + payload_length + 1 > sizeof(packet);
+    if (!damaged) {
+        if (packet_length < 4 + payload_length + 1) {
+            return;
+        }
+
+        uint8_t checksum = 0;
+        for (uint32_t i = 1; i < packet_length - 1; i++) {
+            checksum += packet[i];
+        }
+        damaged = checksum != packet[packet_length - 1];
+    }
+
+    uint32_t length = packet_length;
+    packet_length = 0;
+    if (!damaged) {
+        if (packet[1] == TELEMETRY_PACKET_LEVEL_REQUEST && payload_length >= 2) {
+            send_level(fd, packet[4] | packet[5] << 8);
+        }
+        return;
+    }
+
+    // The sync byte was a data byte, the next packet may start in what was taken for this one
+    static uint8_t rest[sizeof(packet)];
+    memcpy(rest, packet + 1, length - 1);
+    for (uint32_t i = 0; i < length - 1; i++) {
+        receive_byte(fd, rest[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <pack> <device>\n", argv[0]);
+        return 1;
+    }
+    if (!load_pack(argv[1])) {
+        return 1;
+    }
+    int fd = open_device(argv[2]);
+    if (fd < 0) {
+        return 1;
+    }
+    fprintf(stderr, "serving %d levels on %s\n", pack_levels, argv[2]);
+
+    uint8_t buffer[256];
+    ssize_t size;
+    while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < size; i++) {
+            receive_byte(fd, buffer[i]);
+        }
+    }
+
+    return 0;
+}
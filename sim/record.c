@@ -0,0 +1,169 @@
+#include "record.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "hal.h"
+#include "display.h"
+
+// One frame: the buttons held down and the hash of what was shown
+struct record_entry {
+    uint32_t buttons;
+    uint32_t hash;
+};
+
+// A run, as a growing array of frames
+struct record {
+    struct record_entry *entries;
+    int entry_count;
+};
+
+// The run being recorded, and the one loaded to check against
+static struct record recorded;
+static struct record loaded;
+
+// Same letters as in input scripts
+static const struct {
+    uint32_t button;
+    char c;
+} button_chars[] = {
+    { BUTTON_PIN_A_DOWN, 'a' },
+    { BUTTON_PIN_A_UP, 'A' },
+    { BUTTON_PIN_P_DOWN, 'p' },
+    { BUTTON_PIN_P_UP, 'P' },
+    { BUTTON_PIN_THROW, 't' },
+};
+
+static uint32_t frame_hash(uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (int x = 0; x < DISPLAY_WIDTH; x++) {
+            hash = (hash ^ levels[y][x]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void entry_add(struct record *record, uint32_t buttons, uint32_t hash) {
+    int count = record->entry_count;
+    if ((count & (count - 1)) == 0) {
+        // Grow at every power of two
+        record->entries = realloc(record->entries, (count ? 2 * count : 1) * sizeof(*record->entries));
+    }
+    record->entries[count].buttons = buttons;
+    record->entries[count].hash = hash;
+    record->entry_count++;
+}
+
+// Repeats the last frame of 'record' up to 'count' frames
+static void entries_extend(struct record *record, int count) {
+    while (record->entry_count < count) {
+        entry_add(record, 0, record->entries[record->entry_count - 1].hash);
+    }
+}
+
+static void write_buttons(FILE *f, int frames, uint32_t buttons) {
+    fprintf(f, "%d ", frames);
+    if (buttons == 0) {
+        fputc('-', f);
+    }
+    for (size_t i = 0; i < sizeof(button_chars) / sizeof(button_chars[0]); i++) {
+        if (buttons & button_chars[i].button) {
+            fputc(button_chars[i].c, f);
+        }
+    }
+    fputc('\n', f);
+}
+
+void record_frame(uint32_t buttons, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    entry_add(&recorded, buttons, frame_hash(levels));
+}
+
+bool record_save(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    const struct record_entry *entries = recorded.entries;
+    int entry_count = recorded.entry_count;
+
+    fprintf(f, "# %d frames at %d bpp\n", entry_count, DISPLAY_BPP);
+
+    int run_start = 0;
+    for (int i = 1; i <= entry_count; i++) {
+        if (i == entry_count || entries[i].buttons != entries[run_start].buttons) {
+            write_buttons(f, i - run_start, entries[run_start].buttons);
+            run_start = i;
+        }
+    }
+
+    for (int i = 0; i < entry_count; i++) {
+        if (i == 0 || entries[i].hash != entries[i - 1].hash) {
+            fprintf(f, "= %d %08x\n", i, entries[i].hash);
+        }
+    }
+
+    fclose(f);
+
+    return true;
+}
+
+bool record_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    int frames = -1, bpp = -1;
+    loaded.entry_count = 0;
+
+    char line[128];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        int frame;
+        uint32_t hash;
+        if (frames < 0 && sscanf(line, "# %d frames at %d bpp", &frames, &bpp) == 2) {
+            continue;
+        }
+        if (sscanf(line, "= %d %x", &frame, &hash) != 2 || frame < loaded.entry_count ||
+                (loaded.entry_count == 0 && frame != 0)) {
+            continue;
+        }
+        // Every frame up to this one looks like the last one
+        entries_extend(&loaded, frame);
+        entry_add(&loaded, 0, hash);
+    }
+
+    fclose(f);
+
+    if (frames < 0 || loaded.entry_count == 0) {
+        fprintf(stderr, "%s: not a recording\n", path);
+        return false;
+    }
+    if (bpp != DISPLAY_BPP) {
+        fprintf(stderr, "%s: recorded at %d bpp, this is built for %d\n", path, bpp, DISPLAY_BPP);
+        return false;
+    }
+    entries_extend(&loaded, frames);
+
+    return true;
+}
+
+int record_frame_count() {
+    return loaded.entry_count;
+}
+
+bool record_check(int frame, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    uint32_t hash = frame_hash(levels);
+    if (frame >= loaded.entry_count || hash == loaded.entries[frame].hash) {
+        return true;
+    }
+
+    fprintf(stderr, "frame %d: hash %08x, recorded %08x\n", frame, hash, loaded.entries[frame].hash);
+    return false;
+}
@@ -0,0 +1,28 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "display.h"
+
+// Recordings of a run: the buttons of every frame and a hash of every frame shown, so that the run can be replayed
+// and checked against what it looked like when it was recorded.
+//
+// A recording is a text file that is also an input script (see sim.c): a '# <frames> frames at <bpp> bpp' line,
+// the buttons as '<frames> <buttons>' lines, one per run of frames with the same buttons, and a '= <frame> <hash>'
+// line for every frame that looks different from the one before it.
+
+// Adds the next frame of the run being recorded
+void record_frame(uint32_t buttons, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]);
+// Writes the run recorded so far to 'path'
+bool record_save(const char *path);
+
+// Reads the hashes of a recording, returns false if it can't be read or was recorded at another DISPLAY_BPP
+bool record_load(const char *path);
+// Number of frames in the recording loaded
+int record_frame_count();
+// Compares 'frame' of the run with the recording loaded, returns false (and says so on stderr) if it differs
+bool record_check(int frame, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]);
+
+#endif /* __RECORD_H__ */
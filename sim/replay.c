@@ -0,0 +1,199 @@
+#include "replay.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "display.h"
+#include "game.h"
+#include "telemetry.h"
+
+// Largest frame, four bit-planes
+#define FRAME_SIZE_MAX (DISPLAY_WIDTH * DISPLAY_HEIGHT / 8 * 4)
+
+static const char *const state_names[] = {
+    [GAME_STATE_AIM] = "aim",
+    [GAME_STATE_THROW] = "throw",
+    [GAME_STATE_UPDATE_WORLD] = "update_world",
+    [GAME_STATE_LOST] = "lost",
+    [GAME_STATE_WON] = "won",
+};
+
+static const char *const counter_names[TELEMETRY_COUNTER_COUNT] = {
+    [TELEMETRY_COUNTER_FRAMES_RUN] = "frames run",
+    [TELEMETRY_COUNTER_DEADLINE_MISSES] = "deadline misses",
+    [TELEMETRY_COUNTER_FRAME_CYCLES_MAX] = "frame cycles max",
+    [TELEMETRY_COUNTER_FRAMES_RENDERED] = "frames rendered",
+    [TELEMETRY_COUNTER_FRAMES_SKIPPED] = "frames skipped",
+    [TELEMETRY_COUNTER_FRAMES_UNCHANGED] = "frames unchanged",
+    [TELEMETRY_COUNTER_PHYSICS_UPDATES_DROPPED] = "physics updates dropped",
+    [TELEMETRY_COUNTER_FRAMES_FLIPPED] = "frames flipped",
+    [TELEMETRY_COUNTER_FRAMES_SHOWN] = "frames shown",
+    [TELEMETRY_COUNTER_FRAMES_DROPPED] = "frames dropped",
+    [TELEMETRY_COUNTER_ROWS_ENCODED] = "rows encoded",
+    [TELEMETRY_COUNTER_ROWS_MISSED] = "rows missed",
+    [TELEMETRY_COUNTER_INPUT_EVENTS] = "input events",
+    [TELEMETRY_COUNTER_INPUT_EVENTS_DROPPED] = "input events dropped",
+    [TELEMETRY_COUNTER_PRESS_LATENCY_CYCLES_MAX] = "press latency cycles max",
+    [TELEMETRY_COUNTER_TELEMETRY_FRAMES_SENT] = "telemetry frames sent",
+    [TELEMETRY_COUNTER_TELEMETRY_FRAMES_DROPPED] = "telemetry frames dropped",
+    [TELEMETRY_COUNTER_TELEMETRY_PACKETS_DROPPED] = "telemetry packets dropped",
+    [TELEMETRY_COUNTER_TELEMETRY_BYTES_SENT] = "telemetry bytes sent",
+};
+
+// The last frame decoded, and whether there was a key frame to start from
+static uint8_t frame[FRAME_SIZE_MAX];
+static bool frame_valid;
+
+static uint32_t packets_damaged;
+static uint32_t frames_undecodable;
+
+static uint32_t read32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// Reads the next intact packet, returns its length or -1 at the end of the stream
+static int read_packet(FILE *f, uint8_t *type, uint8_t payload[65536]) {
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c != TELEMETRY_SYNC) {
+            continue;
+        }
+
+        // Remember where the packet starts, to look for the next sync in it if it turns out to be damaged
+        long start = ftell(f);
+        uint8_t header[3];
+        if (fread(header, 1, 3, f) != 3) {
+            return -1;
+        }
+        int length = header[1] | header[2] << 8;
+        int checksum_byte;
+        if ((int) fread(payload, 1, length, f) != length || (checksum_byte = fgetc(f)) == EOF) {
+            return -1;
+        }
+
+        uint8_t checksum = header[0] + header[1] + header[2];
+        for (int i = 0; i < length; i++) {
+            checksum += payload[i];
+        }
+        if (checksum == checksum_byte) {
+            *type = header[0];
+            return length;
+        }
+
+        packets_damaged++;
+        fseek(f, start, SEEK_SET);
+    }
+    return -1;
+}
+
+// Returns false if the frame couldn't be decoded
+static bool decode_frame(const uint8_t *payload, int length, int *bpp) {
+    if (length < 2 || payload[1] < 1 || payload[1] > 4) {
+        return false;
+    }
+    bool key = payload[0] & TELEMETRY_FRAME_KEY;
+    *bpp = payload[1];
+    int size = DISPLAY_WIDTH * DISPLAY_HEIGHT / 8 * *bpp;
+
+    if (key) {
+        memset(frame, 0, sizeof(frame));
+        frame_valid = true;
+    } else if (!frame_valid) {
+        return false;
+    }
+
+    int i = 0;
+    for (int p = 2; p < length;) {
+        uint8_t control = payload[p++];
+        if (control >= 0x80) {
+            i += control - 0x7f;
+        } else {
+            for (int run = control + 1; run > 0 && p < length && i < size; run--) {
+                frame[i++] ^= payload[p++];
+            }
+        }
+    }
+    if (i != size) {
+        // The delta didn't cover the frame, everything after it is off too
+        frame_valid = false;
+        return false;
+    }
+    return true;
+}
+
+static void frame_levels(int bpp, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    int plane_size = DISPLAY_WIDTH * DISPLAY_HEIGHT / 8;
+    int max = (1 << bpp) - 1;
+
+    for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (int x = 0; x < DISPLAY_WIDTH; x++) {
+            int byte = y * DISPLAY_WIDTH / 8 + x / 8;
+            int value = 0;
+            for (int plane = 0; plane < bpp; plane++) {
+                value |= (frame[plane * plane_size + byte] >> (x % 8) & 1) << plane;
+            }
+            levels[y][x] = value * 255 / max;
+        }
+    }
+}
+
+bool replay_next_frame(FILE *f, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    static uint8_t payload[65536];
+    uint8_t type;
+    int length;
+
+    while ((length = read_packet(f, &type, payload)) >= 0) {
+        switch (type) {
+            case TELEMETRY_PACKET_FRAME: {
+                int bpp;
+                if (decode_frame(payload, length, &bpp)) {
+                    frame_levels(bpp, levels);
+                    return true;
+                }
+                frames_undecodable++;
+                break;
+            }
+
+            case TELEMETRY_PACKET_STATE:
+                if (length >= 3 && payload[0] <= GAME_STATE_WON) {
+                    fprintf(stderr, "state: %s, level %d\n", state_names[payload[0]], payload[1] | payload[2] << 8);
+                }
+                break;
+
+            case TELEMETRY_PACKET_COUNTERS:
+                for (int i = 0; i < TELEMETRY_COUNTER_COUNT && (i + 1) * 4 <= length; i++) {
+                    fprintf(stderr, "counter: %-26s %10u\n", counter_names[i], read32(payload + i * 4));
+                }
+                break;
+
+            case TELEMETRY_PACKET_PROFILE:
+                for (int p = 0; p + 17 <= length; p += 17) {
+                    fprintf(stderr, "profile: zone %d (see enum profile_zone): %u samples, %u min, %u avg, %u max\n", payload[p],
+                        read32(payload + p + 1), read32(payload + p + 5), read32(payload + p + 9),
+                        read32(payload + p + 13));
+                }
+                break;
+
+            case TELEMETRY_PACKET_LEVEL_REQUEST:
+                if (length >= 2) {
+                    fprintf(stderr, "level request: %d\n", payload[0] | payload[1] << 8);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return false;
+}
+
+uint32_t replay_packets_damaged() {
+    return packets_damaged;
+}
+
+uint32_t replay_frames_undecodable() {
+    return frames_undecodable;
+}
@@ -0,0 +1,19 @@
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "display.h"
+
+// Decoder for the telemetry stream (see telemetry.h), as recorded from the board's serial port or with -T
+
+// Reads packets up to the next frame and returns how bright each LED is in it (see sim_panel_levels()),
+// printing state changes and counters to stderr on the way. Returns false at the end of the stream.
+bool replay_next_frame(FILE *f, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]);
+// Packets skipped because they were damaged, frames skipped because there was no key frame before them
+uint32_t replay_packets_damaged();
+uint32_t replay_frames_undecodable();
+
+#endif /* __REPLAY_H__ */
@@ -0,0 +1,428 @@
+// Host-side simulator
+// Runs the game code headlessly against the simulated HAL, optionally paced at REFRESH_RATE,
+// and dumps the panel contents as PBM images or to the terminal
+
+// For the pseudo-terminal functions
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#include "hal.h"
+#include "hal_sim.h"
+#include "display.h"
+#include "canvas.h"
+#include "game.h"
+#include "frame.h"
+#include "input.h"
+#include "profile.h"
+#include "telemetry.h"
+#include "loader.h"
+#include "bench.h"
+#include "replay.h"
+#include "record.h"
+
+// From off to fully lit
+static const char level_chars[] = ".-:=+*%#";
+
+struct input_step {
+    int frames;
+    uint32_t buttons;
+};
+
+// The input script, each line is '<frames> <buttons>' where <buttons> is any combination of
+// 'a'/'A' (angle down/up), 'p'/'P' (power down/up), 't' (throw) or '-' for none
+static struct input_step *input_steps;
+static size_t input_step_count;
+
+static void print_profile_line(const char *line) {
+    fprintf(stderr, "profile: %s\n", line);
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n <frames>  Number of frames to simulate (default: 300)\n"
+        "  -i <file>    Input script\n"
+        "  -r           Run in real time (paced at %d Hz)\n"
+        "  -t           Print frames to the terminal\n"
+        "  -p <dir>     Write frames as PBM/PGM images to <dir>\n"
+        "  -b <file>    Record the bitstream sent to the display\n"
+        "  -T <file>    Record the telemetry stream\n"
+        "  -R <file>    Show the frames of a telemetry stream (from the board or -T) instead of running the game\n"
+        "  -u           Connect the telemetry UART to a pseudo-terminal, levels are loaded through it from\n"
+        "               angry-pixel-levelserve\n"
+        "  -w <file>    Record the run (its input and a hash of every frame shown)\n"
+        "  -c <file>    Replay a recording and check that every frame still looks the same, fails if not\n"
+        "  -B <name>    Run a benchmark ('all' for all of them) and exit:\n",
+        argv0, REFRESH_RATE);
+    bench_list();
+}
+
+// Opens a pseudo-terminal to stand in for the board's serial port, returns the non-blocking master end or -1
+static int open_pty() {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("pty");
+        return -1;
+    }
+
+    // Keep the other end open too and make it raw, so that nothing is echoed back and the master can be read
+    // before anyone connects
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+        perror(ptsname(master));
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    fprintf(stderr, "telemetry UART on %s\n", ptsname(master));
+
+    return master;
+}
+
+static bool load_input_script(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        int frames;
+        char buttons_str[16];
+
+        if (line[0] == '#' || sscanf(line, "%d %15s", &frames, buttons_str) != 2) {
+            continue;
+        }
+
+        uint32_t buttons = 0;
+        for (const char *c = buttons_str; *c != '\0'; c++) {
+            switch (*c) {
+                case 'a': buttons |= BUTTON_PIN_A_DOWN; break;
+                case 'A': buttons |= BUTTON_PIN_A_UP; break;
+                case 'p': buttons |= BUTTON_PIN_P_DOWN; break;
+                case 'P': buttons |= BUTTON_PIN_P_UP; break;
+                case 't': buttons |= BUTTON_PIN_THROW; break;
+                default: break;
+            }
+        }
+
+        input_steps = realloc(input_steps, (input_step_count + 1) * sizeof(*input_steps));
+        input_steps[input_step_count].frames = frames;
+        input_steps[input_step_count].buttons = buttons;
+        input_step_count++;
+    }
+
+    fclose(f);
+
+    return true;
+}
+
+static uint32_t input_for_frame(int frame) {
+    for (size_t i = 0; i < input_step_count; i++) {
+        if (frame < input_steps[i].frames) {
+            return input_steps[i].buttons;
+        }
+        frame -= input_steps[i].frames;
+    }
+
+    return 0;
+}
+
+static void print_panel(FILE *f, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (int x = 0; x < DISPLAY_WIDTH; x++) {
+            // Anything that is lit at all gets at least the second character
+            int index = (levels[y][x] * (sizeof(level_chars) - 2) + 254) / 255;
+            fputc(level_chars[index], f);
+        }
+        fputc('\n', f);
+    }
+}
+
+// Writes a PBM image, or a PGM image if there are shades of gray
+static void write_image(const char *dir, int frame, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH]) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/frame_%05d.%s", dir, frame, DISPLAY_BPP > 1 ? "pgm" : "pbm");
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return;
+    }
+
+    if (DISPLAY_BPP > 1) {
+        fprintf(f, "P2\n%d %d\n255\n", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    } else {
+        // Lit LEDs are written as 1 (black)
+        fprintf(f, "P1\n%d %d\n", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    }
+
+    for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (int x = 0; x < DISPLAY_WIDTH; x++) {
+            if (DISPLAY_BPP > 1) {
+                fprintf(f, "%d ", levels[y][x]);
+            } else {
+                fputc(levels[y][x] > 0 ? '1' : '0', f);
+            }
+        }
+        fputc('\n', f);
+    }
+
+    fclose(f);
+}
+
+// Shows a frame the way the options say, in the terminal and/or as an image
+static void view_frame(int frame, uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH], bool terminal, bool realtime,
+        const char *pbm_dir) {
+    if (terminal) {
+        if (realtime) {
+            // Redraw in place
+            fputs("\033[H\033[2J", stdout);
+        }
+        printf("frame %d\n", frame);
+        print_panel(stdout, levels);
+        putchar('\n');
+        fflush(stdout);
+    }
+
+    if (pbm_dir != NULL) {
+        write_image(pbm_dir, frame, levels);
+    }
+}
+
+int main(int argc, char **argv) {
+    int frame_count = 300;
+    bool realtime = false;
+    bool terminal = false;
+    const char *pbm_dir = NULL;
+    FILE *bitstream_file = NULL;
+    const char *bench_name = NULL;
+    FILE *telemetry_file = NULL;
+    FILE *replay_file = NULL;
+    const char *record_path = NULL;
+    int uart_fd = -1;
+    bool check = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:rtp:b:T:R:uw:c:B:h")) != -1) {
+        switch (opt) {
+            case 'n': frame_count = atoi(optarg); break;
+            case 'i':
+                if (!load_input_script(optarg)) {
+                    return 1;
+                }
+                break;
+            case 'r': realtime = true; break;
+            case 't': terminal = true; break;
+            case 'p': pbm_dir = optarg; break;
+            case 'B': bench_name = optarg; break;
+            case 'b':
+                bitstream_file = fopen(optarg, "w");
+                if (bitstream_file == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                sim_bitstream_record(bitstream_file);
+                break;
+            case 'T':
+                telemetry_file = fopen(optarg, "wb");
+                if (telemetry_file == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                sim_uart_record(telemetry_file);
+                break;
+            case 'R':
+                replay_file = fopen(optarg, "rb");
+                if (replay_file == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'u':
+                uart_fd = open_pty();
+                if (uart_fd < 0) {
+                    return 1;
+                }
+                sim_uart_connect(uart_fd);
+                break;
+            case 'w': record_path = optarg; break;
+            case 'c':
+                // A recording is also an input script
+                if (!record_load(optarg) || !load_input_script(optarg)) {
+                    return 1;
+                }
+                frame_count = record_frame_count();
+                check = true;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    static uint8_t levels[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+
+    if (replay_file != NULL) {
+        int frame = 0;
+        while (replay_next_frame(replay_file, levels)) {
+            view_frame(frame++, levels, terminal, false, pbm_dir);
+        }
+        fprintf(stderr, "replay: %d frames, %u damaged packets, %u frames without a key frame before them\n",
+            frame, replay_packets_damaged(), replay_frames_undecodable());
+        fclose(replay_file);
+        return 0;
+    }
+
+    hal_init();
+    input_init();
+
+    display_init();
+
+    canvas_set_buffer(display_get_back_buffer());
+
+    // Before the game starts, as on the board (see main.c)
+    if (telemetry_file != NULL || uart_fd >= 0) {
+        telemetry_init();
+    }
+    if (uart_fd >= 0) {
+        loader_init();
+    }
+
+    game_init();
+
+    if (bench_name != NULL) {
+        if (!bench_run(bench_name)) {
+            usage(argv[0]);
+            return 1;
+        }
+        return 0;
+    }
+
+    int mismatches = 0;
+    uint64_t tick_ns = 0;
+    uint64_t scan_ns = 0;
+    uint64_t start = now_ns();
+    uint64_t next_frame = start;
+
+    for (int frame = 0; frame < frame_count; frame++) {
+        uint32_t buttons = input_for_frame(frame);
+        sim_buttons_set(buttons);
+
+        uint64_t t0 = now_ns();
+        // The frame timer interrupt, then the main loop
+        frame_post();
+        frame_run();
+        uint64_t t1 = now_ns();
+        sim_panel_reset();
+        sim_scan_for(FRAME_CYCLES);
+        uint64_t t2 = now_ns();
+
+        tick_ns += t1 - t0;
+        scan_ns += t2 - t1;
+
+        sim_panel_levels(levels);
+        view_frame(frame, levels, terminal, realtime, pbm_dir);
+
+        if (record_path != NULL) {
+            record_frame(buttons, levels);
+        }
+        if (check && !record_check(frame, levels)) {
+            mismatches++;
+        }
+
+        if (realtime) {
+            next_frame += 1000000000 / REFRESH_RATE;
+            uint64_t now = now_ns();
+            if (next_frame > now) {
+                uint64_t wait = next_frame - now;
+                struct timespec ts = { wait / 1000000000, wait % 1000000000 };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+
+    uint64_t total_ns = now_ns() - start;
+
+    fprintf(stderr, "%d frames in %.3f ms (%.0f frames/s)\n",
+        frame_count, total_ns / 1e6, frame_count / (total_ns / 1e9));
+    fprintf(stderr, "frame_run:       %8.0f ns/frame\n", (double) tick_ns / frame_count);
+    fprintf(stderr, "display scan:    %8.0f ns/frame (%.0f pin writes/frame)\n",
+        (double) scan_ns / frame_count, (double) sim_display_writes() / frame_count);
+
+    const struct display_stats *display_stats = display_get_stats();
+    fprintf(stderr, "display: %u frames flipped, %u shown, %u dropped\n",
+        display_stats->frames_flipped, display_stats->frames_shown, display_stats->frames_dropped);
+    fprintf(stderr, "display: %.2f rows encoded per frame\n",
+        display_stats->frames_flipped ? (double) display_stats->rows_encoded / display_stats->frames_flipped : 0.0);
+    fprintf(stderr, "display: %u rows scanned, %u missed, %u ns max per row (period %u ns)\n",
+        display_stats->rows_scanned, display_stats->rows_missed, display_stats->row_cycles_max, DISPLAY_ROW_PERIOD);
+
+    const struct game_stats *game_stats = game_get_stats();
+    fprintf(stderr, "game: %u physics steps, %u ns on average, %u ns max\n",
+        game_stats->physics_steps, game_stats->physics_steps ? game_stats->physics_cycles / game_stats->physics_steps : 0,
+        game_stats->physics_cycles_max);
+    fprintf(stderr, "game: %u frames rendered, %u skipped, %u unchanged, %u physics updates dropped\n",
+        game_stats->frames_rendered, game_stats->frames_skipped, game_stats->frames_unchanged,
+        game_stats->physics_updates_dropped);
+
+    const struct frame_stats *frame_stats = frame_get_stats();
+    fprintf(stderr, "frames: %u run, %u ns on average, %u ns max (budget %u ns), %u deadlines missed\n",
+        frame_stats->frames_run, frame_stats->frames_run ? frame_stats->frame_cycles / frame_stats->frames_run : 0,
+        frame_stats->frame_cycles_max, FRAME_CYCLES, frame_stats->deadline_misses);
+    const struct input_stats *input_stats = input_get_stats();
+    fprintf(stderr, "input: %u events, %u dropped, %u presses, %u ns latency on average, %u ns max\n",
+        input_stats->events, input_stats->events_dropped, frame_stats->presses,
+        frame_stats->presses ? frame_stats->press_latency_cycles / frame_stats->presses : 0,
+        frame_stats->press_latency_cycles_max);
+
+    if (telemetry_file != NULL) {
+        const struct telemetry_stats *telemetry_stats = telemetry_get_stats();
+        fprintf(stderr, "telemetry: %u frames sent, %u dropped, %u other packets dropped, %u bytes\n",
+            telemetry_stats->frames_sent, telemetry_stats->frames_dropped, telemetry_stats->packets_dropped,
+            telemetry_stats->bytes_sent);
+        fclose(telemetry_file);
+    }
+
+    if (uart_fd >= 0) {
+        const struct loader_stats *loader_stats = loader_get_stats();
+        fprintf(stderr, "loader: %u requests, %u levels received, %u damaged, %u cache hits, %u misses, "
+            "%u evictions\n", loader_stats->requests, loader_stats->packets, loader_stats->packets_damaged,
+            loader_stats->cache_hits, loader_stats->cache_misses, loader_stats->evictions);
+    }
+
+    profile_dump(print_profile_line);
+
+    if (bitstream_file != NULL) {
+        fclose(bitstream_file);
+    }
+
+    if (record_path != NULL && !record_save(record_path)) {
+        return 1;
+    }
+    if (check) {
+        fprintf(stderr, "check: %d frames, %d differ from the recording\n", frame_count, mismatches);
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+// Level solver
+// Throws the pixel with every aim the buttons can set, using the game's own physics and world update, and
+// searches for the shortest sequence of throws that clears each level. The throws of each search step are spread
+// over one worker process per core, each with its own copy of the game state.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// The solver needs the game's internals, not just its interface
+#include "game.c"
+
+// Aims tried: every angle step around the full turn, and every power step above 0 up to SOLVE_POWER_MAX
+#define SOLVE_ANGLE_STEPS ((FIXED_ANGLE_TURN + ANGLE_INPUT_SPEED - 1) / ANGLE_INPUT_SPEED)
+#define SOLVE_POWER_MAX fixed_from_int(16)
+// Power steps down from the default aim to the weakest throw, and up to the strongest
+#define SOLVE_POWER_STEPS_DOWN ((fixed_from_int(4) - 1) / POWER_INPUT_SPEED)
+#define SOLVE_POWER_STEPS_UP ((SOLVE_POWER_MAX - fixed_from_int(4)) / POWER_INPUT_SPEED)
+#define SOLVE_POWER_STEPS (SOLVE_POWER_STEPS_DOWN + 1 + SOLVE_POWER_STEPS_UP)
+#define SOLVE_AIMS (SOLVE_ANGLE_STEPS * SOLVE_POWER_STEPS)
+
+// A throw that takes longer than this is given up on, in physics updates
+#define SOLVE_UPDATES_MAX (60 * PHYSICS_RATE)
+
+// Everything a throw depends on besides the aim
+struct world {
+    struct grid grid;
+    int not_moving_count;
+};
+
+// A world reached by the search, and how: from which world, with which aim
+struct node {
+    struct world world;
+    int parent;
+    int aim;
+    int throws;
+};
+
+// What a worker found: throwing 'aim' in node 'from' leads to 'world', or clears the level
+struct result {
+    int from;
+    int aim;
+    bool won;
+    struct world world;
+};
+
+// Results a worker writes at once, see expand()
+#define SOLVE_RESULTS_PER_WRITE ((int) (PIPE_BUF / sizeof(struct result)))
+
+// The game times its physics updates, which is of no interest here: reading the clock would take about as long
+// as the update itself
+uint32_t hal_cycles() {
+    return 0;
+}
+
+// The built-in levels only, no loader
+const struct level *loader_level(int index) {
+    return &levels[index];
+}
+
+void loader_prefetch(int index) {
+    (void) index;
+}
+
+int loader_level_count() {
+    return level_count;
+}
+
+// All worlds reached so far, and a hash table of indices into it (-1 for empty slots) to find them again
+static struct node *nodes;
+static int node_count;
+static int node_capacity;
+static int *node_table;
+static int node_table_size;
+
+// What the workers found in the current search step
+static struct result *results;
+static int result_capacity;
+
+static fixed_angle_t aim_angle_of(int aim) {
+    return FIXED_ANGLE_TURN / 8 + (aim / SOLVE_POWER_STEPS) * ANGLE_INPUT_SPEED;
+}
+
+static int aim_power_step(int aim) {
+    return aim % SOLVE_POWER_STEPS - SOLVE_POWER_STEPS_DOWN;
+}
+
+static fixed_t aim_power_of(int aim) {
+    return fixed_from_int(4) + aim_power_step(aim) * POWER_INPUT_SPEED;
+}
+
+static uint32_t world_hash(const struct world *world) {
+    // FNV-1a
+    const uint8_t *bytes = (const uint8_t *) world;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(*world); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void world_get(struct world *world) {
+    memset(world, 0, sizeof(*world));
+    world->grid = grid;
+    world->not_moving_count = not_moving_count;
+}
+
+static void world_set(const struct world *world) {
+    grid = world->grid;
+    not_moving_count = world->not_moving_count;
+}
+
+// Returns the index of the node for 'world', or -1 if there is none yet
+static int node_find(const struct world *world) {
+    for (uint32_t i = world_hash(world);; i++) {
+        int index = node_table[i & (node_table_size - 1)];
+        if (index < 0 || memcmp(&nodes[index].world, world, sizeof(*world)) == 0) {
+            return index;
+        }
+    }
+}
+
+static void node_add(const struct world *world, int parent, int aim, int throws) {
+    if (node_count == node_capacity) {
+        node_capacity = node_capacity ? node_capacity * 2 : 1024;
+        nodes = realloc(nodes, node_capacity * sizeof(*nodes));
+    }
+    if (2 * (node_count + 1) > node_table_size) {
+        // Keep the table at most half full, rehash everything into a bigger one
+        node_table_size = node_table_size ? node_table_size * 2 : 4096;
+        free(node_table);
+        node_table = malloc(node_table_size * sizeof(*node_table));
+        memset(node_table, 0xff, node_table_size * sizeof(*node_table));
+        for (int i = 0; i < node_count; i++) {
+            uint32_t slot = world_hash(&nodes[i].world);
+            while (node_table[slot & (node_table_size - 1)] >= 0) {
+                slot++;
+            }
+            node_table[slot & (node_table_size - 1)] = i;
+        }
+    }
+
+    nodes[node_count] = (struct node) { *world, parent, aim, throws };
+    uint32_t slot = world_hash(world);
+    while (node_table[slot & (node_table_size - 1)] >= 0) {
+        slot++;
+    }
+    node_table[slot & (node_table_size - 1)] = node_count;
+    node_count++;
+}
+
+static int result_compare(const void *a, const void *b) {
+    const struct result *result_a = a, *result_b = b;
+    if (result_a->from != result_b->from) {
+        return result_a->from - result_b->from;
+    }
+    return result_a->aim - result_b->aim;
+}
+
+// Throws the pixel from 'world' and lets everything settle, returns the state the game ends up in
+static enum game_state throw_pixel(const struct world *world, int aim) {
+    world_set(world);
+    game_state = GAME_STATE_AIM;
+    input_start_timeout = 0;
+    // Never run out of pixels, the search counts them
+    pixels_available = INT32_MAX;
+    aim_angle = aim_angle_of(aim);
+    aim_power = aim_power_of(aim);
+
+    update(0, BUTTON_PIN_THROW);
+    for (int i = 0; i < SOLVE_UPDATES_MAX && game_state != GAME_STATE_AIM && game_state != GAME_STATE_WON; i++) {
+        update(0, 0);
+    }
+
+    return game_state;
+}
+
+// Expands the nodes from 'first' to 'last' (exclusive) whose index modulo 'workers' is 'worker', writes a
+// result for every throw that changes the world (once per world reached from a node) to 'fd'
+static void expand(int first, int last, int worker, int workers, int fd) {
+    struct result *found = malloc(SOLVE_AIMS * sizeof(*found));
+
+    for (int from = first + worker; from < last; from += workers) {
+        int found_count = 0;
+
+        for (int aim = 0; aim < SOLVE_AIMS; aim++) {
+            struct result result = { .from = from, .aim = aim };
+            result.won = throw_pixel(&nodes[from].world, aim) == GAME_STATE_WON;
+            world_get(&result.world);
+
+            if (!result.won && memcmp(&result.world, &nodes[from].world, sizeof(result.world)) == 0) {
+                // Missed
+                continue;
+            }
+
+            bool seen = false;
+            for (int i = 0; i < found_count && !seen; i++) {
+                seen = found[i].won == result.won && (result.won ||
+                    memcmp(&found[i].world, &result.world, sizeof(result.world)) == 0);
+            }
+            if (!seen) {
+                found[found_count++] = result;
+            }
+        }
+
+        // All workers write to the same pipe: only writes of up to PIPE_BUF bytes are atomic, so whole results
+        // are written that many at a time to keep them from getting mixed up with another worker's
+        for (int i = 0; i < found_count; i += SOLVE_RESULTS_PER_WRITE) {
+            int count = found_count - i < SOLVE_RESULTS_PER_WRITE ? found_count - i : SOLVE_RESULTS_PER_WRITE;
+            if (write(fd, &found[i], count * sizeof(*found)) != (ssize_t) (count * sizeof(*found))) {
+                perror("write");
+                exit(1);
+            }
+        }
+    }
+
+    free(found);
+}
+
+// Returns the index of the node the level was cleared from (with the winning aim in 'won_aim'), or -1 if it
+// can't be cleared with 'throws_max' throws
+static int solve(int level, int throws_max, int workers, int *won_aim) {
+    load_level(level);
+    node_count = 0;
+    node_table_size = 0;
+
+    struct world start;
+    world_get(&start);
+    node_add(&start, -1, -1, 0);
+
+    // Breadth first, so the first win takes the fewest throws
+    int first = 0;
+    for (int throws = 0; throws < throws_max && first < node_count; throws++) {
+        int last = node_count;
+
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            exit(1);
+        }
+        for (int worker = 0; worker < workers; worker++) {
+            if (fork() == 0) {
+                close(fds[0]);
+                expand(first, last, worker, workers, fds[1]);
+                _exit(0);
+            }
+        }
+        close(fds[1]);
+
+        // Collect everything first: the workers finish in any order, but numbering the new nodes in the order of
+        // the nodes and aims they came from finds the same solution however many workers there are
+        FILE *f = fdopen(fds[0], "rb");
+        int result_count = 0;
+        while (true) {
+            if (result_count == result_capacity) {
+                result_capacity = result_capacity ? result_capacity * 2 : 1024;
+                results = realloc(results, result_capacity * sizeof(*results));
+            }
+            if (fread(&results[result_count], sizeof(*results), 1, f) != 1) {
+                break;
+            }
+            result_count++;
+        }
+        fclose(f);
+        while (wait(NULL) > 0) {
+        }
+        qsort(results, result_count, sizeof(*results), result_compare);
+
+        int winner = -1;
+        for (int i = 0; i < result_count && winner < 0; i++) {
+            if (results[i].won) {
+                winner = results[i].from;
+                *won_aim = results[i].aim;
+            } else if (node_find(&results[i].world) < 0) {
+                node_add(&results[i].world, results[i].from, results[i].aim, throws + 1);
+            }
+        }
+
+        if (winner >= 0) {
+            return winner;
+        }
+        first = last;
+    }
+
+    return -1;
+}
+
+static void print_aim(int throw, int aim) {
+    printf("  throw %d: angle %+d steps, power %+d steps\n", throw, aim / SOLVE_POWER_STEPS, aim_power_step(aim));
+}
+
+int main(int argc, char **argv) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cores > 0 ? cores : 1;
+    if (argc > 1) {
+        workers = atoi(argv[1]);
+    }
+
+    printf("%d aims per throw (%d angles x %d powers), %d worker(s)\n", SOLVE_AIMS, SOLVE_ANGLE_STEPS,
+        SOLVE_POWER_STEPS, workers);
+    printf("aims are given in button steps from the default one, angle up / power up being positive\n");
+
+    for (int level = 0; level < (int) level_count; level++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+
+        int budget = levels[level].pixels;
+        int won_aim = -1;
+        int winner = solve(level, budget, workers, &won_aim);
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+        if (winner < 0) {
+            printf("level %d: not solvable with %d pixels (%d worlds searched, %.2f s)\n", level, budget, node_count,
+                seconds);
+            continue;
+        }
+
+        int throws = nodes[winner].throws + 1;
+        printf("level %d: solvable, %d of %d pixels (%d worlds searched, %.2f s)\n", level, throws, budget, node_count,
+            seconds);
+
+        // Walk back from the win to the start
+        int path[throws];
+        path[throws - 1] = won_aim;
+        for (int node = winner, i = throws - 2; i >= 0; node = nodes[node].parent, i--) {
+            path[i] = nodes[node].aim;
+        }
+        for (int i = 0; i < throws; i++) {
+            print_aim(i + 1, path[i]);
+        }
+    }
+
+    return 0;
+}
@@ -1,22 +1,210 @@
 
 #include "canvas.h"
 
+#include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 
+#include "hal.h"
+#include "profile.h"
+
 #define CANVAS_BOUNDS_CHECK(x, y) ((x) < 0 || (x) >= CANVAS_WIDTH || (y) < 0 || (y) >= CANVAS_HEIGHT)
 
+#define CANVAS_PLANE_SIZE ((CANVAS_WIDTH * CANVAS_HEIGHT) / 8)
+
+#define CANVAS_LEVEL_MAX ((1 << CANVAS_BPP) - 1)
+
+// Words per row and per plane
+#define CANVAS_ROW_WORDS (CANVAS_WIDTH / 32)
+#define CANVAS_PLANE_WORDS (CANVAS_ROW_WORDS * CANVAS_HEIGHT)
+
 // This is the buffer we draw to, every bit is a pixel/LED
+// With more than one bit per pixel, bit n of a pixel is in bit-plane n
+// Rows are accessed as two 32-bit words (little-endian, so bit x of the row is pixel x), single pixels as bytes
 static uint8_t *canvas_buffer;
+static uint32_t *canvas_words;
+
+// Rows changed since canvas_set_buffer(), bit y for row y
+static uint16_t canvas_dirty_rows;
+
+// The level pixels are set to, one bit per plane
+static uint8_t canvas_level = CANVAS_LEVEL_MAX;
 
 // canvas.c doesn't transfer the buffer to the display, that's what display.c does
 
+enum canvas_op {
+    CANVAS_OP_SET,
+    CANVAS_OP_CLEAR,
+    CANVAS_OP_XOR
+};
+
+// A rectangle clipped to the canvas, in whole pixels, plus which of its edges are still on the canvas
+struct canvas_rect {
+    int x1, y1, x2, y2;
+    bool left_visible, right_visible, top_visible, bottom_visible;
+};
+
+// Normalizes and clips the rectangle once, returns false if nothing of it is visible
+static bool canvas_rect_clip(int x1, int y1, int x2, int y2, struct canvas_rect *rect) {
+    if (x1 > x2) {
+        int tmp = x2;
+        x2 = x1;
+        x1 = tmp;
+    }
+    if (y1 > y2) {
+        int tmp = y2;
+        y2 = y1;
+        y1 = tmp;
+    }
+
+    if (x2 < 0 || x1 >= CANVAS_WIDTH || y2 < 0 || y1 >= CANVAS_HEIGHT) {
+        return false;
+    }
+
+    rect->left_visible = x1 >= 0;
+    rect->right_visible = x2 < CANVAS_WIDTH;
+    rect->top_visible = y1 >= 0;
+    rect->bottom_visible = y2 < CANVAS_HEIGHT;
+
+    rect->x1 = rect->left_visible ? x1 : 0;
+    rect->x2 = rect->right_visible ? x2 : CANVAS_WIDTH - 1;
+    rect->y1 = rect->top_visible ? y1 : 0;
+    rect->y2 = rect->bottom_visible ? y2 : CANVAS_HEIGHT - 1;
+
+    return true;
+}
+
+// Bits x1 to x2 (inclusive), both have to be on the canvas
+static inline uint64_t canvas_span_mask(int x1, int x2) {
+    return (~(uint64_t) 0 >> (CANVAS_WIDTH - 1 - x2)) & (~(uint64_t) 0 << x1);
+}
+
+// Sets, clears or toggles the pixels in 'mask' in row 'y', in every plane according to the current level
+static void canvas_row_apply(int y, uint64_t mask, enum canvas_op op) {
+    uint32_t mask_lo = (uint32_t) mask;
+    uint32_t mask_hi = (uint32_t) (mask >> 32);
+
+    uint32_t *row = &canvas_words[y * CANVAS_ROW_WORDS];
+    uint32_t changed = 0;
+
+    for (uint8_t plane = 0; plane < CANVAS_BPP; plane++) {
+        bool bit = canvas_level & (1 << plane);
+        uint32_t lo = row[0], hi = row[1];
+
+        if (op == CANVAS_OP_CLEAR || (op == CANVAS_OP_SET && !bit)) {
+            lo &= ~mask_lo;
+            hi &= ~mask_hi;
+        } else if (op == CANVAS_OP_SET) {
+            lo |= mask_lo;
+            hi |= mask_hi;
+        } else if (bit) {
+            lo ^= mask_lo;
+            hi ^= mask_hi;
+        }
+
+        changed |= (lo ^ row[0]) | (hi ^ row[1]);
+        row[0] = lo;
+        row[1] = hi;
+
+        row += CANVAS_PLANE_WORDS;
+    }
+
+    if (changed) {
+        canvas_dirty_rows |= 1 << y;
+    }
+}
+
+// Replaces the pixels in 'window' in row 'y' with 'bits', in every plane according to the current level
+static void canvas_row_replace(int y, uint64_t window, uint64_t bits) {
+    uint32_t window_lo = (uint32_t) window;
+    uint32_t window_hi = (uint32_t) (window >> 32);
+    uint32_t bits_lo = (uint32_t) bits;
+    uint32_t bits_hi = (uint32_t) (bits >> 32);
+
+    uint32_t *row = &canvas_words[y * CANVAS_ROW_WORDS];
+    uint32_t changed = 0;
+
+    for (uint8_t plane = 0; plane < CANVAS_BPP; plane++) {
+        uint32_t lo = row[0] & ~window_lo, hi = row[1] & ~window_hi;
+        if (canvas_level & (1 << plane)) {
+            lo |= bits_lo;
+            hi |= bits_hi;
+        }
+
+        changed |= (lo ^ row[0]) | (hi ^ row[1]);
+        row[0] = lo;
+        row[1] = hi;
+
+        row += CANVAS_PLANE_WORDS;
+    }
+
+    if (changed) {
+        canvas_dirty_rows |= 1 << y;
+    }
+}
+
 void canvas_set_buffer(uint8_t *buffer) {
+    // The buffer has to be word-aligned (see display.c)
     canvas_buffer = buffer;
+    canvas_words = (uint32_t *) buffer;
+    canvas_dirty_rows = 0;
+}
+
+uint8_t *canvas_get_buffer() {
+    return canvas_buffer;
+}
+
+uint16_t canvas_get_dirty_rows() {
+    return canvas_dirty_rows;
 }
 
 void canvas_clear() {
-    memset(canvas_buffer, 0x00, (CANVAS_WIDTH * CANVAS_HEIGHT) / 8);
+    for (int y = 0; y < CANVAS_HEIGHT; y++) {
+        uint32_t *row = &canvas_words[y * CANVAS_ROW_WORDS];
+        uint32_t set = 0;
+
+        for (uint8_t plane = 0; plane < CANVAS_BPP; plane++) {
+            set |= row[0] | row[1];
+            row[0] = 0;
+            row[1] = 0;
+
+            row += CANVAS_PLANE_WORDS;
+        }
+
+        if (set) {
+            canvas_dirty_rows |= 1 << y;
+        }
+    }
+}
+
+void canvas_copy(const uint8_t *layer) {
+    const uint32_t *layer_words = (const uint32_t *) layer;
+
+    // Row by row, so that rows that are the same already stay clean
+    for (int y = 0; y < CANVAS_HEIGHT; y++) {
+        uint32_t *row = &canvas_words[y * CANVAS_ROW_WORDS];
+        const uint32_t *layer_row = &layer_words[y * CANVAS_ROW_WORDS];
+        uint32_t changed = 0;
+
+        for (uint8_t plane = 0; plane < CANVAS_BPP; plane++) {
+            changed |= (row[0] ^ layer_row[0]) | (row[1] ^ layer_row[1]);
+            row[0] = layer_row[0];
+            row[1] = layer_row[1];
+
+            row += CANVAS_PLANE_WORDS;
+            layer_row += CANVAS_PLANE_WORDS;
+        }
+
+        if (changed) {
+            canvas_dirty_rows |= 1 << y;
+        }
+    }
+}
+
+void canvas_set_intensity(uint8_t intensity) {
+    // Round up, so that nothing that should be visible disappears
+    canvas_level = (intensity * CANVAS_LEVEL_MAX + CANVAS_INTENSITY_MAX - 1) / CANVAS_INTENSITY_MAX;
 }
 
 void canvas_pixel_set(int x, int y) {
@@ -24,7 +212,21 @@ void canvas_pixel_set(int x, int y) {
         return;
     }
 
-    canvas_buffer[(y * CANVAS_WIDTH + x) / 8] |= 1 << (x % 8);
+    uint8_t *byte = &canvas_buffer[(y * CANVAS_WIDTH + x) / 8];
+    uint8_t mask = 1 << (x % 8);
+    uint8_t changed = 0;
+
+    for (uint8_t plane = 0; plane < CANVAS_BPP; plane++) {
+        uint8_t old = byte[plane * CANVAS_PLANE_SIZE];
+        uint8_t new = (canvas_level & (1 << plane)) ? old | mask : old & ~mask;
+
+        changed |= old ^ new;
+        byte[plane * CANVAS_PLANE_SIZE] = new;
+    }
+
+    if (changed) {
+        canvas_dirty_rows |= 1 << y;
+    }
 }
 
 void canvas_pixel_clear(int x, int y) {
@@ -32,70 +234,260 @@ void canvas_pixel_clear(int x, int y) {
         return;
     }
 
-    canvas_buffer[(y * CANVAS_WIDTH + x) / 8] &= ~(1 << (x % 8));
+    uint8_t *byte = &canvas_buffer[(y * CANVAS_WIDTH + x) / 8];
+    uint8_t mask = 1 << (x % 8);
+    uint8_t changed = 0;
+
+    for (uint8_t plane = 0; plane < CANVAS_BPP; plane++) {
+        changed |= byte[plane * CANVAS_PLANE_SIZE] & mask;
+        byte[plane * CANVAS_PLANE_SIZE] &= ~mask;
+    }
+
+    if (changed) {
+        canvas_dirty_rows |= 1 << y;
+    }
 }
 
-void canvas_hline(float x1, float x2, float y) {
-    if (x1 > x2) {
-        float tmp = x2;
-        x2 = x1;
-        x1 = tmp;
+void canvas_hline(int x1, int x2, int y) {
+    canvas_rect_fill(x1, y, x2, y);
+}
+
+void canvas_vline(int x, int y1, int y2) {
+    canvas_rect_fill(x, y1, x, y2);
+}
+
+// Range of steps 'i' (starting at 0) for which 'start + step * i' lies within [0, size)
+static bool canvas_axis_range(int start, int step, int size, int *i_min, int *i_max) {
+    if (step > 0) {
+        *i_min = start < 0 ? -start : 0;
+        *i_max = size - 1 - start;
+    } else {
+        *i_min = start >= size ? start - (size - 1) : 0;
+        *i_max = start;
+    }
+
+    return *i_min <= *i_max;
+}
+
+void canvas_line(int x1, int y1, int x2, int y2) {
+    // Bresenham, walking along the major axis: after i steps the minor axis has moved
+    // q(i) = floor((2 * i * d_minor + d_major) / (2 * d_major)) steps
+    int dx = abs(x2 - x1), dy = abs(y2 - y1);
+    int sx = x2 >= x1 ? 1 : -1, sy = y2 >= y1 ? 1 : -1;
+
+    bool x_major = dx >= dy;
+    int d_major = x_major ? dx : dy;
+    int d_minor = x_major ? dy : dx;
+    int major_start = x_major ? x1 : y1, minor_start = x_major ? y1 : x1;
+    int major_step = x_major ? sx : sy, minor_step = x_major ? sy : sx;
+    int major_size = x_major ? CANVAS_WIDTH : CANVAS_HEIGHT;
+    int minor_size = x_major ? CANVAS_HEIGHT : CANVAS_WIDTH;
+
+    // Clip up front: find the steps for which both coordinates are on the canvas
+    int i_min, i_max, q_min, q_max;
+    if (!canvas_axis_range(major_start, major_step, major_size, &i_min, &i_max) ||
+        !canvas_axis_range(minor_start, minor_step, minor_size, &q_min, &q_max)) {
+        return;
+    }
+    if (i_max > d_major) {
+        i_max = d_major;
+    }
+
+    if (d_minor == 0) {
+        // Straight line, the minor axis stays where it is
+        if (q_min > 0) {
+            return;
+        }
+    } else {
+        // First step with q(i) >= q_min, last step with q(i) <= q_max
+        int first = (2 * q_min * d_major - d_major + 2 * d_minor - 1) / (2 * d_minor);
+        int last = ((2 * q_max + 1) * d_major - 1) / (2 * d_minor);
+        if (first > i_min) {
+            i_min = first;
+        }
+        if (last < i_max) {
+            i_max = last;
+        }
     }
 
-    for (int x = (int) x1; x <= (int) x2; x++) {
-        canvas_pixel_set(x, y);
+    if (i_min > i_max) {
+        return;
+    }
+
+    // Where Bresenham would be after i_min steps (a single point has nothing to divide by)
+    int period = d_major > 0 ? 2 * d_major : 1;
+    int numerator = 2 * i_min * d_minor + d_major;
+    int error = numerator % period;
+    int major = major_start + major_step * i_min;
+    int minor = minor_start + minor_step * (numerator / period);
+
+    for (int i = i_min; i <= i_max; i++) {
+        if (x_major) {
+            canvas_row_apply(minor, (uint64_t) 1 << major, CANVAS_OP_SET);
+        } else {
+            canvas_row_apply(major, (uint64_t) 1 << minor, CANVAS_OP_SET);
+        }
+
+        major += major_step;
+        error += 2 * d_minor;
+        if (error >= period) {
+            error -= period;
+            minor += minor_step;
+        }
     }
 }
 
-void canvas_vline(float x, float y1, float y2) {
-    if (y1 > y2) {
-        float tmp = y2;
-        y2 = y1;
-        y1 = tmp;
+void canvas_rect_fill(int x1, int y1, int x2, int y2) {
+    struct canvas_rect rect;
+    if (!canvas_rect_clip(x1, y1, x2, y2, &rect)) {
+        return;
     }
 
-    for (int y = (int) y1; y <= (int) y2; y++) {
-        canvas_pixel_set(x, y);
+    uint64_t mask = canvas_span_mask(rect.x1, rect.x2);
+
+    for (int y = rect.y1; y <= rect.y2; y++) {
+        canvas_row_apply(y, mask, CANVAS_OP_SET);
     }
 }
 
-void canvas_rect_fill(float x1, float y1, float x2, float y2) {
-    if (x1 > x2) {
-        float tmp = x2;
-        x2 = x1;
-        x1 = tmp;
+void canvas_rect_stroke(int x1, int y1, int x2, int y2) {
+    struct canvas_rect rect;
+    if (!canvas_rect_clip(x1, y1, x2, y2, &rect)) {
+        return;
     }
-    if (y1 > y2) {
-        float tmp = y2;
-        y2 = y1;
-        y1 = tmp;
+
+    uint64_t span = canvas_span_mask(rect.x1, rect.x2);
+
+    // Only the edges that weren't clipped away
+    uint64_t sides = 0;
+    if (rect.left_visible) {
+        sides |= (uint64_t) 1 << rect.x1;
+    }
+    if (rect.right_visible) {
+        sides |= (uint64_t) 1 << rect.x2;
+    }
+
+    for (int y = rect.y1; y <= rect.y2; y++) {
+        bool horizontal_edge = (y == rect.y1 && rect.top_visible) || (y == rect.y2 && rect.bottom_visible);
+        canvas_row_apply(y, horizontal_edge ? span : sides, CANVAS_OP_SET);
+    }
+}
+
+// Span from x1 to x2 in row y, clipped
+static inline void canvas_circle_span(int y, int x1, int x2) {
+    if (y < 0 || y >= CANVAS_HEIGHT) {
+        return;
+    }
+    if (x1 < 0) {
+        x1 = 0;
+    }
+    if (x2 >= CANVAS_WIDTH) {
+        x2 = CANVAS_WIDTH - 1;
+    }
+    if (x1 <= x2) {
+        canvas_row_apply(y, canvas_span_mask(x1, x2), CANVAS_OP_SET);
+    }
+}
+
+// Pixels x1 and x2 in row y, clipped
+static inline void canvas_circle_points(int y, int x1, int x2) {
+    if (y < 0 || y >= CANVAS_HEIGHT) {
+        return;
+    }
+
+    uint64_t mask = 0;
+    if (x1 >= 0 && x1 < CANVAS_WIDTH) {
+        mask |= (uint64_t) 1 << x1;
+    }
+    if (x2 >= 0 && x2 < CANVAS_WIDTH) {
+        mask |= (uint64_t) 1 << x2;
+    }
+    canvas_row_apply(y, mask, CANVAS_OP_SET);
+}
+
+// Midpoint circle: walks one octant and mirrors it, calling 'row' for the two rows each step touches
+static void canvas_circle(int cx, int cy, int r, void (*row)(int y, int x1, int x2)) {
+    // Clip up front: nothing to do if the bounding box is off the canvas
+    if (r < 0 || cx + r < 0 || cx - r >= CANVAS_WIDTH || cy + r < 0 || cy - r >= CANVAS_HEIGHT) {
+        return;
     }
 
-    for (int y = (int) y1; y <= (int) y2; y++) {
-        for (int x = (int) x1; x <= (int) x2; x++) {
-            canvas_pixel_set((int) x, (int) y);
+    int x = r, y = 0;
+    int d = 1 - r;
+
+    while (x >= y) {
+        row(cy + y, cx - x, cx + x);
+        row(cy - y, cx - x, cx + x);
+        row(cy + x, cx - y, cx + y);
+        row(cy - x, cx - y, cx + y);
+
+        y++;
+        if (d < 0) {
+            d += 2 * y + 1;
+        } else {
+            x--;
+            d += 2 * (y - x) + 1;
         }
     }
 }
 
-void canvas_rect_stroke(float x1, float y1, float x2, float y2) {
-    canvas_hline(x1, x2, y1);
-    canvas_vline(x2, y1, y2);
-    canvas_hline(x2, x1, y2);
-    canvas_vline(x1, y2, y1);
+void canvas_circle_fill(int x, int y, int r) {
+    canvas_circle(x, y, r, canvas_circle_span);
+}
+
+void canvas_circle_stroke(int x, int y, int r) {
+    canvas_circle(x, y, r, canvas_circle_points);
 }
 
 void canvas_bitmap(int offset_x, int offset_y, const uint8_t *bitmap, int w, int h) {
+    PROFILE_BEGIN(PROFILE_ZONE_BITMAP);
+    canvas_blit(offset_x, offset_y, bitmap, w, h, CANVAS_BLIT_OPAQUE);
+    PROFILE_END(PROFILE_ZONE_BITMAP);
+}
+
+void canvas_blit(int offset_x, int offset_y, const uint8_t *bitmap, int w, int h, enum canvas_blit_mode mode) {
+    // Clip once: nothing to do if the bitmap is entirely off the canvas
+    if (w <= 0 || w > CANVAS_WIDTH || offset_x >= CANVAS_WIDTH || offset_x + w <= 0) {
+        return;
+    }
+
+    int y_start = offset_y < 0 ? -offset_y : 0;
+    int y_end = offset_y + h > CANVAS_HEIGHT ? CANVAS_HEIGHT - offset_y : h;
+
     int bytes_per_row = (w + 7) / 8;
 
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
-            // The MSB is drawn left-most
-            if (bitmap[y * bytes_per_row + x / 8] & (1 << (7 - (x % 8)))) {
-                canvas_pixel_set(offset_x + x, offset_y + y);
-            } else {
-                canvas_pixel_clear(offset_x + x, offset_y + y);
-            }
+    // The part of a canvas row the bitmap covers
+    int x1 = offset_x < 0 ? 0 : offset_x;
+    int x2 = offset_x + w - 1 >= CANVAS_WIDTH ? CANVAS_WIDTH - 1 : offset_x + w - 1;
+    uint64_t window = canvas_span_mask(x1, x2);
+    uint64_t source_mask = canvas_span_mask(0, w - 1);
+
+    for (int y = y_start; y < y_end; y++) {
+        const uint8_t *source = &bitmap[y * bytes_per_row];
+
+        // The MSB is drawn left-most: collect the row MSB-first, then reverse it so that bit x is pixel x
+        uint32_t hi = 0, lo = 0;
+        for (int i = 0; i < bytes_per_row && i < 4; i++) {
+            hi |= (uint32_t) source[i] << (24 - 8 * i);
+        }
+        for (int i = 4; i < bytes_per_row; i++) {
+            lo |= (uint32_t) source[i] << (56 - 8 * i);
+        }
+        uint64_t row = ((uint64_t) hal_rbit(lo) << 32 | hal_rbit(hi)) & source_mask;
+
+        // Shift it into place
+        row = offset_x >= 0 ? row << offset_x : row >> -offset_x;
+
+        switch (mode) {
+            case CANVAS_BLIT_OPAQUE:
+                canvas_row_replace(offset_y + y, window, row);
+                break;
+            case CANVAS_BLIT_TRANSPARENT:
+                canvas_row_apply(offset_y + y, row, CANVAS_OP_SET);
+                break;
+            case CANVAS_BLIT_XOR:
+                canvas_row_apply(offset_y + y, row, CANVAS_OP_XOR);
+                break;
         }
     }
 }
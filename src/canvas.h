@@ -7,17 +7,50 @@
 #define CANVAS_WIDTH 64
 #define CANVAS_HEIGHT 16
 
+// Bits per pixel, the buffer holds one bit-plane after the other (see display.h)
+#ifndef DISPLAY_BPP
+#define DISPLAY_BPP 1
+#endif
+#define CANVAS_BPP DISPLAY_BPP
+
+// Bytes in a buffer for canvas_set_buffer(), all planes
+#define CANVAS_BUFFER_SIZE (CANVAS_BPP * CANVAS_WIDTH * CANVAS_HEIGHT / 8)
+
+// Intensities are given as 0 to CANVAS_INTENSITY_MAX regardless of CANVAS_BPP
+#define CANVAS_INTENSITY_MAX 255
+
+// How canvas_blit() combines a bitmap with what is already on the canvas
+enum canvas_blit_mode {
+    // Set pixels are drawn, clear pixels are cleared
+    CANVAS_BLIT_OPAQUE,
+    // Set pixels are drawn, clear pixels are left alone
+    CANVAS_BLIT_TRANSPARENT,
+    // Set pixels are toggled
+    CANVAS_BLIT_XOR
+};
+
+// Buffers have to be word-aligned
 void canvas_set_buffer(uint8_t *buffer);
+uint8_t *canvas_get_buffer();
+// Rows that changed since canvas_set_buffer(), bit y for row y
+uint16_t canvas_get_dirty_rows();
 void canvas_clear();
+// Replaces everything on the canvas with 'layer', another buffer that was drawn to before
+void canvas_copy(const uint8_t *layer);
+// Sets the intensity that everything after this is drawn with, anything above 0 is at least the dimmest level
+void canvas_set_intensity(uint8_t intensity);
 void canvas_pixel_set(int x, int y);
 void canvas_pixel_clear(int x, int y);
-void canvas_hline(float x1, float x2, float y);
-void canvas_vline(float x, float y1, float y2);
-void canvas_line(float x1, float y1, float x2, float y2);
-void canvas_rect_fill(float x1, float y1, float x2, float y2);
-void canvas_rect_stroke(float x1, float y1, float x2, float y2);
-void canvas_circle_fill(float x, float y, float r);
-void canvas_circle_stroke(float x, float y, float r);
+void canvas_hline(int x1, int x2, int y);
+void canvas_vline(int x, int y1, int y2);
+void canvas_line(int x1, int y1, int x2, int y2);
+void canvas_rect_fill(int x1, int y1, int x2, int y2);
+void canvas_rect_stroke(int x1, int y1, int x2, int y2);
+void canvas_circle_fill(int x, int y, int r);
+void canvas_circle_stroke(int x, int y, int r);
+// Bitmaps are stored row by row, (w + 7) / 8 bytes per row, the MSB of each byte is drawn left-most
+// w can be at most CANVAS_WIDTH
 void canvas_bitmap(int offset_x, int offset_y, const uint8_t *bitmap, int w, int h);
+void canvas_blit(int offset_x, int offset_y, const uint8_t *bitmap, int w, int h, enum canvas_blit_mode mode);
 
 #endif /* __CANVAS_H__ */
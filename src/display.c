@@ -3,63 +3,297 @@
 
 #include <stdint.h>
 
-#include <driverlib/sysctl.h>
-#include <inc/hw_types.h>
+#include "hal.h"
+#include "profile.h"
 
-// We use this macro for really fast GPIO access
-#define fast_GPIOPinWrite(base, pins, data) (HWREG((base) | (pins) << 2) = (data))
+// Each buffer holds DISPLAY_BPP bit-planes, plane 0 is the least significant bit of each pixel's intensity
+// Stored as words so that it can be encoded a word at a time, the canvas sees bytes (bit x % 8 of byte x / 8)
+static uint32_t display_buffers[DISPLAY_BUFFER_COUNT][DISPLAY_BPP][DISPLAY_HEIGHT][DISPLAY_WIDTH / 32];
 
-static uint8_t display_buffer[DISPLAY_HEIGHT][DISPLAY_WIDTH / 8];
+// Every buffer is encoded into the order the bits are sent in when it's flipped, so that the scan only has
+// to stream words out. Same layout as display_buffers.
+static uint32_t display_tx[DISPLAY_BUFFER_COUNT][DISPLAY_BPP][DISPLAY_HEIGHT][DISPLAY_WIDTH / 32];
 
-void display_init() {
-    // Configure GPIO pins
-    SysCtlPeripheralEnable(DISPLAY_PORT_PERIPH);
-    // Access the GPIO registers over the AHB, for increased performance
-    SysCtlGPIOAHBEnable(DISPLAY_PORT_PERIPH);
-    GPIOPinTypeGPIOOutput(DISPLAY_PORT_BASE, DISPLAY_PINS);
-    fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_PINS, 0x00);
-}
+// The buffer being scanned out, the buffer being drawn to and the complete frame in between
+// Only ever swapped with interrupts disabled, so each buffer has exactly one owner at all times
+static volatile uint8_t front_index = 0;
+static volatile uint8_t back_index = 1;
+static volatile uint8_t pending_index = 2;
+// Whether pending_index holds a frame that wasn't shown yet
+static volatile bool pending_ready = false;
+
+static struct display_stats stats;
 
-uint8_t *display_get_buffer() {
+uint8_t *display_get_back_buffer() {
     // Make the underlying buffer accessible to the outside world (see canvas.c)
-    return display_buffer;
+    return (uint8_t *) display_buffers[back_index];
 }
 
-void display_refresh() {
-    // Push the buffer out
+static inline uint32_t display_encode_word(uint32_t pixels) {
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+    // The SSI sends byte by byte, MSB first: reverse the bits of the word, then put the bytes back in order
+    return hal_rev(hal_rbit(~pixels));
+#else
+    // Shifted out LSB first, only 'DATA' being active low needs taking care of
+    return ~pixels;
+#endif
+}
 
-    // The display is essentially a 64-bit-wide buffered shift register
-    // One of the 16 lines at a time displays the contents of that shift register
-    // A pulse on 'SHIFT' shifts the date on 'DATA' in from the left
-    // A pulse on 'LATCH' transfers the data to the shift registers output buffer
-    // The signals 'LINE_A' to 'LINE_D' select the active line
+// Returns the number of rows encoded
+static uint32_t display_encode(uint8_t index, uint16_t rows) {
+    uint32_t count = 0;
 
-    // Iterate over all 16 lines
     for (uint8_t line = 0; line < DISPLAY_HEIGHT; line++) {
-        // Shift the lines data out
-        for (uint8_t byte_index = 0; byte_index < DISPLAY_WIDTH / 8; byte_index++) {
-            uint8_t data = display_buffer[line][byte_index];
+        if (!(rows & (1 << line))) {
+            continue;
+        }
+
+        for (uint8_t plane = 0; plane < DISPLAY_BPP; plane++) {
+            const uint32_t *pixels = display_buffers[index][plane][line];
+            uint32_t *tx = display_tx[index][plane][line];
+
+            for (uint8_t i = 0; i < DISPLAY_WIDTH / 32; i++) {
+                tx[i] = display_encode_word(pixels[i]);
+            }
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+uint8_t *display_flip(uint16_t rows) {
+    // The back buffer belongs to us until it's swapped below
+    uint32_t start = hal_cycles();
+    stats.rows_encoded += display_encode(back_index, rows);
+    stats.encode_cycles = hal_cycles() - start;
+    PROFILE_RECORD(PROFILE_ZONE_FLIP, stats.encode_cycles);
+
+    bool was_disabled = hal_interrupts_disable();
+
+    if (pending_ready) {
+        // The scan didn't get to the previous frame
+        stats.frames_dropped++;
+    }
+
+    uint8_t index = pending_index;
+    pending_index = back_index;
+    back_index = index;
+    pending_ready = true;
+
+    stats.frames_flipped++;
+
+    hal_interrupts_restore(was_disabled);
+
+    return (uint8_t *) display_buffers[back_index];
+}
+
+const struct display_stats *display_get_stats() {
+    return &stats;
+}
+
+// Switches to the latest complete frame, if there is one
+static void display_scan_begin() {
+    bool was_disabled = hal_interrupts_disable();
+
+    if (pending_ready) {
+        uint8_t index = front_index;
+        front_index = pending_index;
+        pending_index = index;
+        pending_ready = false;
+
+        stats.frames_shown++;
+    }
+
+    hal_interrupts_restore(was_disabled);
+}
+
+// The display is essentially a 64-bit-wide buffered shift register
+// One of the 16 lines at a time displays the contents of that shift register
+// A pulse on 'SHIFT' shifts the date on 'DATA' in from the left
+// A pulse on 'LATCH' transfers the data to the shift registers output buffer
+// The signals 'LINE_A' to 'LINE_D' select the active line
+// 'ENABLE' is active low, the LEDs are dark while it is high
+//
+// The lines are scanned from a timer interrupt. The time slot of each line is split into one slot per bit-plane,
+// plane n getting 2^n units of time (binary code modulation). Each interrupt first latches the plane that was
+// shifted in during the previous slot and then starts shifting in the next one, so every plane is lit for exactly
+// its slot no matter how long the shifting takes. Every plane is shifted exactly once per line.
+// The global brightness shortens the time 'ENABLE' is active within each slot.
+
+// The line and plane whose data is in (or on its way into) the shift register
+static volatile uint8_t scan_line;
+static volatile uint8_t scan_plane;
+// Whether all bits of the plane have been shifted in
+static volatile bool line_ready;
+
+// Length of each plane's slot and how long 'ENABLE' is active in it, in hal_cycles()
+static uint32_t plane_periods[DISPLAY_BPP];
+static uint32_t plane_windows[DISPLAY_BPP];
+
+static uint32_t last_row_cycles;
+
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_GPIO
+
+static void display_line_start(uint8_t line, uint8_t plane) {
+    const uint32_t *line_tx = display_tx[front_index][plane][line];
+
+    // Shift the lines data out
+    for (uint8_t word_index = 0; word_index < DISPLAY_WIDTH / 32; word_index++) {
+        uint32_t data = line_tx[word_index];
+
+        for (uint8_t i = 0; i < 32; i++) {
+            uint8_t data_bit = (data & 0x1) ? DISPLAY_PIN_DATA : 0;
+
+            // Apply the data
+            hal_display_write(DISPLAY_PIN_DATA, data_bit);
+
+            // Shift a single bit by pulsing 'SHIFT'
+            hal_display_write(DISPLAY_PIN_SHIFT, DISPLAY_PIN_SHIFT);
+            hal_display_write(DISPLAY_PIN_SHIFT, 0);
+
+            // Next bit
+            data >>= 1;
+        }
+    }
 
-            for (uint8_t i = 0; i < 8; i++) {
-                uint8_t data_bit = !(data & 0x1) ? DISPLAY_PIN_DATA : 0;
+    line_ready = true;
+}
+
+static void display_backend_init() {
+}
+
+#elif DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+
+// 'DATA' and 'SHIFT' come from the SSI, fed by the uDMA. Same signals as the GPIO backend.
+
+static void display_line_start(uint8_t line, uint8_t plane) {
+    // Already in the order the SSI sends it, see display_encode_word()
+    hal_ssi_transfer((const uint8_t *) display_tx[front_index][plane][line], DISPLAY_WIDTH / 8);
+}
+
+// Called from the SSI interrupt once the last bit of a line has been shifted out
+static void display_line_done() {
+    line_ready = true;
+}
+
+static void display_backend_init() {
+    hal_ssi_init(display_line_done);
+}
 
-                // Apply the data
-                fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_PIN_DATA, data_bit);
+#endif
+
+void display_set_brightness(uint8_t brightness) {
+    // Plane n gets 2^n of the (2^DISPLAY_BPP - 1) units a line is lit
+    uint32_t unit = DISPLAY_ROW_PERIOD / ((1 << DISPLAY_BPP) - 1);
+
+    bool was_disabled = hal_interrupts_disable();
+
+    for (uint8_t plane = 0; plane < DISPLAY_BPP; plane++) {
+        plane_periods[plane] = unit << plane;
+        plane_windows[plane] = (brightness == DISPLAY_BRIGHTNESS_MAX) ?
+            plane_periods[plane] : (uint32_t) ((uint64_t) plane_periods[plane] * brightness / 256);
+    }
+
+    hal_interrupts_restore(was_disabled);
+}
+
+void display_init() {
+    hal_display_init();
+    display_backend_init();
+
+    display_set_brightness(DISPLAY_BRIGHTNESS_MAX);
+
+    // All buffers start out blank
+    for (uint8_t index = 0; index < DISPLAY_BUFFER_COUNT; index++) {
+        display_encode(index, DISPLAY_ROWS_ALL);
+    }
 
-                // Shift a single bit by pulsing 'SHIFT'
-                fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_PIN_SHIFT, DISPLAY_PIN_SHIFT);
-                fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_PIN_SHIFT, 0);
+    stats.row_interval_min = UINT32_MAX;
 
-                // Next bit
-                data >>= 1;
+    // Get the first plane on its way, the first interrupt latches it
+    display_scan_begin();
+    scan_line = 0;
+    scan_plane = 0;
+    display_line_start(0, 0);
+
+    hal_scan_timer_init(plane_periods[0], display_scan_row);
+}
+
+void display_scan_row() {
+    uint32_t start = hal_cycles();
+
+    uint8_t line = scan_line;
+    uint8_t plane = scan_plane;
+    uint32_t slot_period = plane_periods[plane];
+
+    if (!line_ready) {
+        // The plane didn't make it into the shift register in time, keep showing the current one for another slot
+        stats.rows_missed++;
+        hal_scan_timer_next(slot_period);
+        return;
+    }
+
+    if (plane == 0) {
+        if (stats.rows_scanned > 0) {
+            uint32_t interval = start - last_row_cycles;
+            if (interval < stats.row_interval_min) {
+                stats.row_interval_min = interval;
+            }
+            if (interval > stats.row_interval_max) {
+                stats.row_interval_max = interval;
             }
         }
+        last_row_cycles = start;
+
+        stats.rows_scanned++;
+    }
+
+    // Dark while switching
+    hal_display_write(DISPLAY_PIN_ENABLE, DISPLAY_PIN_ENABLE);
 
-        // Update the selected line
-        fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_LINE_PINS, line << 4);
+    // Update the selected line
+    hal_display_write(DISPLAY_LINE_PINS, line << 4);
 
-        // Latch the new data
-        fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_PIN_LATCH, DISPLAY_PIN_LATCH);
-        fast_GPIOPinWrite(DISPLAY_PORT_BASE, DISPLAY_PIN_LATCH, 0);
+    // Latch the new data
+    hal_display_write(DISPLAY_PIN_LATCH, DISPLAY_PIN_LATCH);
+    hal_display_write(DISPLAY_PIN_LATCH, 0);
+
+    // Light it up for the plane's window
+    if (plane_windows[plane] > 0) {
+        hal_display_write(DISPLAY_PIN_ENABLE, 0);
+        if (plane_windows[plane] < plane_periods[plane]) {
+            hal_display_blank_after(plane_windows[plane]);
+        }
+    }
+
+    // Start shifting in the next plane
+    plane++;
+    if (plane == DISPLAY_BPP) {
+        plane = 0;
+        line++;
+        if (line == DISPLAY_HEIGHT) {
+            line = 0;
+            display_scan_begin();
+        }
+    }
+
+    // The slot that follows the one that just started belongs to the plane we're about to shift in
+    hal_scan_timer_next(plane_periods[plane]);
+
+    scan_line = line;
+    scan_plane = plane;
+    line_ready = false;
+    display_line_start(line, plane);
+
+    uint32_t cycles = hal_cycles() - start;
+    PROFILE_RECORD(PROFILE_ZONE_SCAN_ROW, cycles);
+    if (cycles > stats.row_cycles_max) {
+        stats.row_cycles_max = cycles;
+    }
+    if (cycles > slot_period) {
+        // We ran into the next slot
+        stats.rows_missed++;
     }
 }
@@ -1,35 +1,69 @@
-
 #ifndef __DISPLAY_H__
 #define __DISPLAY_H__
 
 #include <stdint.h>
 #include <stdbool.h>
 
-#include <driverlib/gpio.h>
-#include <inc/hw_memmap.h>
+#include "hal.h"
 
 #define DISPLAY_WIDTH 64
 #define DISPLAY_HEIGHT 16
+// Row masks have a bit per row (see display_flip())
+#define DISPLAY_ROWS_ALL ((uint16_t) ((1 << DISPLAY_HEIGHT) - 1))
+
+// Bits per pixel, 1 to 4. With more than one bit the display is driven with binary code modulation.
+// Has to match the canvas (see canvas.h).
+#ifndef DISPLAY_BPP
+#define DISPLAY_BPP 1
+#endif
+#if DISPLAY_BPP < 1 || DISPLAY_BPP > 4
+#error "DISPLAY_BPP has to be between 1 and 4"
+#endif
+
+// How often the whole display is scanned per second, one timer interrupt per line and bit-plane
+#define DISPLAY_REFRESH_RATE 120
+// Time each line is lit, in hal_cycles()
+#define DISPLAY_ROW_PERIOD (HAL_CYCLES_PER_SECOND / (DISPLAY_REFRESH_RATE * DISPLAY_HEIGHT))
+
+#define DISPLAY_BRIGHTNESS_MAX 255
+
+// The buffer that is scanned out is never drawn to: the game draws to the back buffer and hands it over with
+// display_flip(), the scan picks up the most recent complete frame when it starts the next pass
+#define DISPLAY_BUFFER_COUNT 3
+
+struct display_stats {
+    // Frames handed over with display_flip()
+    uint32_t frames_flipped;
+    // Frames picked up by the scan
+    uint32_t frames_shown;
+    // Frames replaced by a newer one before the scan got to them
+    uint32_t frames_dropped;
+    // Time it took to encode the last flipped frame, in hal_cycles()
+    uint32_t encode_cycles;
+    // Rows encoded by display_flip(), in total
+    uint32_t rows_encoded;
 
-#define DISPLAY_PORT_PERIPH SYSCTL_PERIPH_GPIOB
-#define DISPLAY_PORT_BASE GPIO_PORTB_AHB_BASE
-
-#define DISPLAY_PIN_DATA GPIO_PIN_0
-#define DISPLAY_PIN_SHIFT GPIO_PIN_1
-#define DISPLAY_PIN_LATCH GPIO_PIN_2
-#define DISPLAY_PIN_ENABLE GPIO_PIN_3
-#define DISPLAY_PIN_LINE_A GPIO_PIN_4
-#define DISPLAY_PIN_LINE_B GPIO_PIN_5
-#define DISPLAY_PIN_LINE_C GPIO_PIN_6
-#define DISPLAY_PIN_LINE_D GPIO_PIN_7
-#define DISPLAY_LINE_PINS (DISPLAY_PIN_LINE_A | DISPLAY_PIN_LINE_B | DISPLAY_PIN_LINE_C | DISPLAY_PIN_LINE_D)
-#define DISPLAY_PINS (\
-    DISPLAY_PIN_DATA | DISPLAY_PIN_SHIFT | DISPLAY_PIN_LATCH | DISPLAY_PIN_ENABLE | \
-    DISPLAY_LINE_PINS \
-)
+    // Lines latched
+    uint32_t rows_scanned;
+    // Deadlines missed: plane not shifted in when its time slot started, or the interrupt overran
+    uint32_t rows_missed;
+    // Longest time spent in display_scan_row(), in hal_cycles()
+    uint32_t row_cycles_max;
+    // Shortest and longest time between two rows, in hal_cycles()
+    uint32_t row_interval_min;
+    uint32_t row_interval_max;
+};
 
 void display_init();
-uint8_t *display_get_buffer();
-void display_refresh();
+// Returns the first bit-plane, the others follow directly
+uint8_t *display_get_back_buffer();
+// Queues the back buffer for display and returns the new back buffer
+// Only the 'rows' (bit y for row y) that changed since the buffer was returned are encoded again
+uint8_t *display_flip(uint16_t rows);
+// Latches the next line (or bit-plane of it) and starts shifting in the one after it, called by the scan timer
+void display_scan_row();
+// Scales the time the LEDs are lit, 0 to DISPLAY_BRIGHTNESS_MAX
+void display_set_brightness(uint8_t brightness);
+const struct display_stats *display_get_stats();
 
 #endif /* __DISPLAY_H__ */
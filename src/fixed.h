@@ -0,0 +1,46 @@
+#ifndef __FIXED_H__
+#define __FIXED_H__
+
+#include <stdint.h>
+
+// Q16.16 fixed-point numbers: the game state never touches the FPU, and the board and the
+// simulator compute exactly the same trajectories
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE ((fixed_t) 1 << FIXED_SHIFT)
+
+// For constants only, rounded to the nearest representable value at compile time
+#define FIXED(x) ((fixed_t) ((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+// Angles as fractions of a full turn, they wrap around on their own
+typedef uint16_t fixed_angle_t;
+
+#define FIXED_ANGLE_TURN 65536
+
+// For constants only, converts radians
+#define FIXED_ANGLE(radians) ((fixed_angle_t) ((radians) * (FIXED_ANGLE_TURN / 6.283185307179586) + 0.5))
+
+static inline fixed_t fixed_from_int(int i) {
+    return (fixed_t) i * FIXED_ONE;
+}
+
+// Rounds towards zero, like casting a float to int
+static inline int fixed_to_int(fixed_t x) {
+    return x >= 0 ? x >> FIXED_SHIFT : -(-x >> FIXED_SHIFT);
+}
+
+// Rounds towards negative infinity (both compilers shift signed values arithmetically)
+static inline fixed_t fixed_mul(fixed_t a, fixed_t b) {
+    return (fixed_t) (((int64_t) a * b) >> FIXED_SHIFT);
+}
+
+static inline fixed_t fixed_abs(fixed_t x) {
+    return x < 0 ? -x : x;
+}
+
+// Table lookup with linear interpolation, within 1 / 65536 of the real thing
+fixed_t fixed_sin(fixed_angle_t angle);
+fixed_t fixed_cos(fixed_angle_t angle);
+
+#endif /* __FIXED_H__ */
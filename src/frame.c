@@ -0,0 +1,101 @@
+
+#include "frame.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hal.h"
+#include "display.h"
+#include "canvas.h"
+#include "game.h"
+#include "input.h"
+#include "telemetry.h"
+#include "loader.h"
+#include "profile.h"
+
+// Ticks posted and not run yet
+static volatile uint32_t frame_ticks;
+
+// The buttons held down, as of the last event
+static uint32_t frame_buttons;
+// Whether a press is waiting for its frame to be flipped, and when it came in
+static bool frame_press_pending;
+static uint32_t frame_press_time;
+
+static struct frame_stats stats;
+
+void frame_post() {
+    frame_ticks++;
+}
+
+bool frame_run() {
+    bool was_disabled = hal_interrupts_disable();
+    uint32_t ticks = frame_ticks;
+    frame_ticks = 0;
+    hal_interrupts_restore(was_disabled);
+
+    if (ticks == 0) {
+        return false;
+    }
+    // More than one tick: the last frame ran into the next one, game_tick() catches up on the ones missed
+    stats.deadline_misses += ticks - 1;
+
+    uint32_t start = hal_cycles();
+    PROFILE_BEGIN(PROFILE_ZONE_FRAME);
+
+    // Levels from the host, before the game might need them
+    loader_poll();
+
+    // Presses that were released again before this frame still count
+    uint32_t pressed = 0;
+    struct input_event event;
+    while (input_next(&event)) {
+        if (event.pressed) {
+            frame_buttons |= event.button;
+            pressed |= event.button;
+
+            if (!frame_press_pending) {
+                frame_press_pending = true;
+                frame_press_time = event.time;
+            }
+        } else {
+            frame_buttons &= ~event.button;
+        }
+    }
+
+    const uint8_t *flipped = NULL;
+    if (game_tick(frame_buttons, pressed, ticks)) {
+        // Hand the frame over to the scan and draw the next one into a fresh buffer
+        flipped = canvas_get_buffer();
+        canvas_set_buffer(display_flip(canvas_get_dirty_rows()));
+
+        if (frame_press_pending) {
+            frame_press_pending = false;
+
+            uint32_t latency = hal_cycles() - frame_press_time;
+            stats.presses++;
+            stats.press_latency_cycles += latency;
+            if (latency > stats.press_latency_cycles_max) {
+                stats.press_latency_cycles_max = latency;
+            }
+        }
+    }
+
+    // Nothing draws to a flipped frame until it comes back as the back buffer, two flips from now
+    telemetry_frame(flipped);
+
+    PROFILE_END(PROFILE_ZONE_FRAME);
+    uint32_t cycles = hal_cycles() - start;
+    stats.frames_run++;
+    stats.frame_cycles += cycles;
+    if (cycles > stats.frame_cycles_max) {
+        stats.frame_cycles_max = cycles;
+    }
+
+    return true;
+}
+
+const struct frame_stats *frame_get_stats() {
+    return &stats;
+}
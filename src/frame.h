@@ -0,0 +1,38 @@
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hal.h"
+#include "game.h"
+
+// Frame scheduler: the frame timer only posts ticks, the game is updated, drawn and flipped for them in
+// thread context, where the display scan interrupts it as it needs to
+
+// hal_cycles() a frame may take
+#define FRAME_CYCLES (HAL_CYCLES_PER_SECOND / REFRESH_RATE)
+
+struct frame_stats {
+    // Frames run, and the time they took in total and at most, in hal_cycles()
+    uint32_t frames_run;
+    uint32_t frame_cycles;
+    uint32_t frame_cycles_max;
+    // Ticks that were posted before the frame of the previous one was done
+    uint32_t deadline_misses;
+
+    // Button presses, and the time from the first edge until the frame that reacted to it was flipped, in total
+    // and at most, in hal_cycles(). The scan shows a flipped frame from its next pass on.
+    uint32_t presses;
+    uint32_t press_latency_cycles;
+    uint32_t press_latency_cycles_max;
+};
+
+// Posts a tick, called from the frame timer interrupt
+void frame_post();
+// Runs the game for the ticks posted since the last call and the input queued meanwhile, returns false if there
+// weren't any ticks
+bool frame_run();
+const struct frame_stats *frame_get_stats();
+
+#endif /* __FRAME_H__ */
@@ -0,0 +1,842 @@
+#include "game.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "hal.h"
+#include "canvas.h"
+#include "fixed.h"
+#include "profile.h"
+
+#include "levels.h"
+#include "loader.h"
+
+#include "bitmaps/digits.c"
+#include "bitmaps/lvl.c"
+#include "bitmaps/cleared.c"
+#include "bitmaps/failed.c"
+#include "bitmaps/retry.c"
+#include "bitmaps/next.c"
+
+#define WIDTH CANVAS_WIDTH
+#define HEIGHT CANVAS_HEIGHT
+
+// Physics updates per second, independent of REFRESH_RATE (the collision check is swept, so long steps don't tunnel)
+#ifndef PHYSICS_RATE
+#define PHYSICS_RATE 30
+#endif
+// Most updates game_tick() runs to catch up, time beyond that is dropped
+#define PHYSICS_UPDATES_MAX 8
+
+// Positions are in pixels, speeds in pixels per physics update, the rates below are converted to that
+// Pixels per second squared
+#define GRAVITY FIXED(-36.0 / (PHYSICS_RATE * PHYSICS_RATE))
+// Speed lost per second while touching the ground or a wall
+#define FRICTION FIXED(1.0 - 3.0 / PHYSICS_RATE)
+#define BOUNCE_FRICTION_X FIXED(0.8)
+#define BOUNCE_FRICTION_Y FIXED(0.0)
+
+// Where the pixel starts, in whole pixels
+#define START_X 6
+#define START_Y 5
+// Brightness of the slingshot stand on displays with more than one bit per pixel
+#define SLINGSHOT_INTENSITY 96
+
+// How fast angle (radians) and power change per second when pressing the buttons
+#define ANGLE_INPUT_SPEED FIXED_ANGLE(1.5 / PHYSICS_RATE)
+#define POWER_INPUT_SPEED FIXED(3.0 / PHYSICS_RATE)
+// Factor between power value and initial speed of the pixel, in pixels per second
+#define AIM_POWER_FACTOR FIXED(9.0 / PHYSICS_RATE)
+
+// 'Kill' pixel when its speed is below 0.6 pixels per second for a second
+#define NOT_MOVING_THRESHOLD FIXED(0.6 / PHYSICS_RATE)
+#define NOT_MOVING_TIMEOUT PHYSICS_RATE
+
+// The world grid fills the right half of the display, cells are 3x3 pixels
+#define GRID_ROWS LEVEL_ROWS
+#define GRID_COLS LEVEL_COLS
+#define GRID_X 32
+#define GRID_CELL_SIZE 3
+
+// How fast boxes and targets fall after the pixel is gone, in pixels per second
+#define FALL_SPEED FIXED(90.0 / PHYSICS_RATE)
+
+// Accept input after a third of a second, to avoid accidentally throwing the pixel
+#define INPUT_START_TIMEOUT (PHYSICS_RATE / 3)
+
+enum grid_cell_type {
+    GRID_CELL_EMPTY = 0,
+    GRID_CELL_SOLID,
+    GRID_CELL_BOX,
+    GRID_CELL_TARGET
+};
+
+// The world grid, one bitmask per object type and row: bit 'col' is set if the cell holds that type
+struct grid {
+    uint16_t solid[GRID_ROWS];
+    uint16_t box[GRID_ROWS];
+    uint16_t target[GRID_ROWS];
+};
+
+// The first occupied grid cell on the pixel's path
+struct collision {
+    enum grid_cell_type type;
+    int row, col;
+    // Whether the path entered the cell through its left or right edge, otherwise top or bottom
+    bool side;
+    // Where it entered, moved out of the cell by the smallest step
+    fixed_t x, y;
+};
+
+// A box or target falling from one cell to another, the grid already has it where it lands
+struct fall {
+    uint8_t col;
+    uint8_t from_row, to_row;
+    uint8_t type;
+};
+
+struct angry_pixel {
+    bool alive;
+    fixed_t x, y;
+    fixed_t vx, vy;
+    // Position before the last update, rendering interpolates from there
+    fixed_t last_x, last_y;
+};
+
+static bool load_level();
+static void settle_world();
+static void update_world();
+static void update_physics();
+
+static enum game_state game_state;
+
+static int current_level;
+
+// The world is divided into grid cells, each can hold a box/wall/target
+static struct grid grid;
+// What is falling after the last throw, at most everything above the bottom row
+static struct fall falls[GRID_COLS * (GRID_ROWS - 1)];
+static int fall_count;
+// Physics updates since the falls started, and the longest one in pixels
+static int fall_time;
+static int fall_distance_max;
+// Where the game goes once everything has landed
+static enum game_state settled_state;
+
+// The grid and the slingshot as last drawn, and whether that's outdated
+static uint32_t world_layer[CANVAS_BUFFER_SIZE / 4];
+static bool world_layer_dirty = true;
+
+// The result screens as last drawn, one each for WON and LOST, tagged with screen_key() of what they show
+struct screen_cache_entry {
+    uint64_t key;
+    uint32_t frame[CANVAS_BUFFER_SIZE / 4];
+};
+static struct screen_cache_entry screen_cache[2];
+// screen_key() of the result screen last handed to the display, 0 if it was the game
+static uint64_t screen_shown;
+
+// Level failed when all available pixels were thrown
+static int pixels_available;
+static int pixels_used;
+
+static struct angry_pixel angry_pixel;
+
+static struct game_stats stats;
+
+// Fixed timestep: every frame adds PHYSICS_RATE, every physics update takes REFRESH_RATE
+// After updating it's in (-REFRESH_RATE, 0], how far the simulation is ahead of the frame
+static int32_t physics_lag;
+// Buttons pressed since the last physics update, kept for frames that run none so that no press is lost
+static uint32_t pressed_pending;
+
+static fixed_angle_t aim_angle;
+static fixed_t aim_power;
+// Where the pixel is on the display
+static fixed_t aim_x, aim_y;
+
+// Counts the frames that the pixel is not moving
+static int not_moving_count;
+
+// Counts the frames until input is accepted
+static int input_start_timeout;
+
+// The level to start as soon as it's there, -1 if none
+static int level_pending = -1;
+
+// Cells in 'row' that hold anything
+static inline uint16_t grid_occupied(int row) {
+    return grid.solid[row] | grid.box[row] | grid.target[row];
+}
+
+static bool grid_has_targets() {
+    uint16_t targets = 0;
+    for (int row = 0; row < GRID_ROWS; row++) {
+        targets |= grid.target[row];
+    }
+
+    return targets != 0;
+}
+
+// What the cell at col/row holds, empty outside the grid
+static enum grid_cell_type grid_cell(int col, int row) {
+    if (col < 0 || col >= GRID_COLS || row < 0 || row >= GRID_ROWS) {
+        return GRID_CELL_EMPTY;
+    }
+
+    uint16_t bit = 1 << col;
+    if (grid.solid[row] & bit) {
+        return GRID_CELL_SOLID;
+    } else if (grid.box[row] & bit) {
+        return GRID_CELL_BOX;
+    } else if (grid.target[row] & bit) {
+        return GRID_CELL_TARGET;
+    }
+
+    return GRID_CELL_EMPTY;
+}
+
+static void grid_cell_set(int col, int row, enum grid_cell_type type) {
+    uint16_t bit = 1 << col;
+
+    world_layer_dirty = true;
+
+    grid.solid[row] &= ~bit;
+    grid.box[row] &= ~bit;
+    grid.target[row] &= ~bit;
+
+    switch (type) {
+        case GRID_CELL_SOLID: grid.solid[row] |= bit; break;
+        case GRID_CELL_BOX: grid.box[row] |= bit; break;
+        case GRID_CELL_TARGET: grid.target[row] |= bit; break;
+        default: break;
+    }
+}
+
+// Returns false if the level isn't there yet, see loader.h
+static bool load_level(int index) {
+    if (index >= loader_level_count()) {
+        return false;
+    }
+    const struct level *level = loader_level(index);
+    if (level == NULL) {
+        return false;
+    }
+
+    current_level = index;
+
+    // The packed level has the same layout as the world grid
+    level_unpack(level, grid.solid, grid.box, grid.target);
+    world_layer_dirty = true;
+
+    pixels_available = level->pixels;
+    pixels_used = 0;
+
+    fall_count = 0;
+
+    angry_pixel.alive = false;
+
+    game_state = GAME_STATE_AIM;
+
+    input_start_timeout = INPUT_START_TIMEOUT;
+
+    level_pending = -1;
+    // Have the next one ready by the time this one is cleared
+    loader_prefetch(index + 1);
+
+    return true;
+}
+
+// Drops every box and target onto whatever is below it in one go, and records the falls for render()
+static void settle_world() {
+    fall_count = 0;
+    fall_time = 0;
+    fall_distance_max = 0;
+
+    world_layer_dirty = true;
+
+    for (int col = 0; col < GRID_COLS; col++) {
+        uint16_t bit = 1 << col;
+
+        // Bottom up, the lowest row the next object can land in
+        int floor = 0;
+        for (int row = 0; row < GRID_ROWS; row++) {
+            if (grid.solid[row] & bit) {
+                floor = row + 1;
+                continue;
+            }
+
+            uint16_t *type_rows;
+            enum grid_cell_type type;
+            if (grid.box[row] & bit) {
+                type_rows = grid.box;
+                type = GRID_CELL_BOX;
+            } else if (grid.target[row] & bit) {
+                type_rows = grid.target;
+                type = GRID_CELL_TARGET;
+            } else {
+                continue;
+            }
+
+            if (row != floor) {
+                type_rows[row] &= ~bit;
+                type_rows[floor] |= bit;
+
+                struct fall *fall = &falls[fall_count++];
+                fall->col = col;
+                fall->from_row = row;
+                fall->to_row = floor;
+                fall->type = type;
+
+                if (3 * (row - floor) > fall_distance_max) {
+                    fall_distance_max = 3 * (row - floor);
+                }
+            }
+
+            floor++;
+        }
+    }
+
+    if (pixels_used < pixels_available) {
+        // The player still has pixels remaining
+        settled_state = GAME_STATE_AIM;
+    } else {
+        // No more pixels :(
+        settled_state = GAME_STATE_LOST;
+    }
+
+    // Proceed with updating the world
+    game_state = GAME_STATE_UPDATE_WORLD;
+}
+
+static void update_world() {
+    // Wait for everything to land before proceeding
+    if (fall_time * FALL_SPEED >= fixed_from_int(fall_distance_max)) {
+        game_state = settled_state;
+        world_layer_dirty = true;
+    } else {
+        fall_time++;
+    }
+}
+
+// Rounds towards negative infinity, b has to be positive
+static int floor_div(int32_t a, int32_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Walks the cells along the path from x0/y0 to x1/y1 in the order it crosses them (DDA)
+// Returns false if none of them, apart from the one it starts in, is occupied
+static bool sweep_grid(fixed_t x0, fixed_t y0, fixed_t x1, fixed_t y1, struct collision *collision) {
+    const fixed_t cell_size = fixed_from_int(GRID_CELL_SIZE);
+
+    // Relative to the grid
+    fixed_t start_x = x0 - fixed_from_int(GRID_X), start_y = y0;
+    fixed_t dx = x1 - x0, dy = y1 - y0;
+
+    int col = floor_div(start_x, cell_size), row = floor_div(start_y, cell_size);
+    int step_col = dx >= 0 ? 1 : -1, step_row = dy >= 0 ? 1 : -1;
+    int cols_left = abs(floor_div(start_x + dx, cell_size) - col);
+    int rows_left = abs(floor_div(start_y + dy, cell_size) - row);
+
+    while (cols_left > 0 || rows_left > 0) {
+        // The next vertical and horizontal cell edge
+        fixed_t edge_x = (step_col > 0 ? col + 1 : col) * cell_size;
+        fixed_t edge_y = (step_row > 0 ? row + 1 : row) * cell_size;
+        int64_t to_edge_x = fixed_abs(edge_x - start_x), to_edge_y = fixed_abs(edge_y - start_y);
+
+        // Cross whichever comes first along the path: to_edge_x / |dx| <= to_edge_y / |dy|
+        bool side = rows_left == 0 ||
+            (cols_left > 0 && to_edge_x * fixed_abs(dy) <= to_edge_y * fixed_abs(dx));
+        if (side) {
+            col += step_col;
+            cols_left--;
+        } else {
+            row += step_row;
+            rows_left--;
+        }
+
+        enum grid_cell_type type = grid_cell(col, row);
+        if (type == GRID_CELL_EMPTY) {
+            continue;
+        }
+
+        collision->type = type;
+        collision->row = row;
+        collision->col = col;
+        collision->side = side;
+        // Cells include their left and bottom edges, so only those need a step back
+        if (side) {
+            collision->x = fixed_from_int(GRID_X) + edge_x - (step_col > 0 ? 1 : 0);
+            collision->y = y0 + (fixed_t) ((int64_t) dy * to_edge_x / fixed_abs(dx));
+        } else {
+            collision->x = x0 + (fixed_t) ((int64_t) dx * to_edge_y / fixed_abs(dy));
+            collision->y = edge_y - (step_row > 0 ? 1 : 0);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static void update_physics() {
+    // Update the pixels position (if 'alive')
+    if (angry_pixel.alive) {
+        fixed_t x0 = angry_pixel.x, y0 = angry_pixel.y;
+        angry_pixel.last_x = x0;
+        angry_pixel.last_y = y0;
+
+        angry_pixel.vy += GRAVITY;
+
+        angry_pixel.x += angry_pixel.vx;
+        angry_pixel.y += angry_pixel.vy;
+
+        // Bounce off the walls
+        if (angry_pixel.x < 0) {
+            angry_pixel.x = 0;
+            angry_pixel.vx = fixed_mul(-angry_pixel.vx, BOUNCE_FRICTION_X);
+            angry_pixel.vy = fixed_mul(angry_pixel.vy, FRICTION);
+        } else if (angry_pixel.x > fixed_from_int(63)) {
+            angry_pixel.x = fixed_from_int(63);
+            angry_pixel.vx = fixed_mul(-angry_pixel.vx, BOUNCE_FRICTION_X);
+            angry_pixel.vy = fixed_mul(angry_pixel.vy, FRICTION);
+        }
+
+        // Bounce off the ground
+        if (angry_pixel.y < 0) {
+            angry_pixel.y = 0;
+            angry_pixel.vy = fixed_mul(-angry_pixel.vy, BOUNCE_FRICTION_Y);
+            angry_pixel.vx = fixed_mul(angry_pixel.vx, FRICTION);
+        }
+
+        // Check collisions with objects anywhere along the way, not just where the pixel ended up
+        struct collision collision;
+        if (sweep_grid(x0, y0, angry_pixel.x, angry_pixel.y, &collision)) {
+            if (collision.type == GRID_CELL_SOLID) {
+                // Bounce off a solid grid cell, from where the pixel hit it
+                angry_pixel.x = collision.x;
+                angry_pixel.y = collision.y;
+
+                if (collision.side) {
+                    // Collided with left or right edge
+                    angry_pixel.vx = fixed_mul(-angry_pixel.vx, BOUNCE_FRICTION_X);
+                    angry_pixel.vy = fixed_mul(angry_pixel.vy, FRICTION);
+                } else {
+                    // Collided with top or bottom edge
+                    angry_pixel.vy = fixed_mul(-angry_pixel.vy, BOUNCE_FRICTION_Y);
+                    angry_pixel.vx = fixed_mul(angry_pixel.vx, FRICTION);
+                }
+            } else {
+                // Grid cell isn't solid
+
+                // Clear the grid cell
+                grid_cell_set(collision.col, collision.row, GRID_CELL_EMPTY);
+
+                if (collision.type == GRID_CELL_TARGET && !grid_has_targets()) {
+                    // The player has cleared the level if there are no more targets left
+                    game_state = GAME_STATE_WON;
+
+                    return;
+                }
+
+                // R.I.P.
+                angry_pixel.alive = false;
+
+                settle_world();
+
+                // No need to do anything else here, the pixel is no more
+                return;
+            }
+        }
+
+        // Check whether the pixel stopped moving
+        if (fixed_abs(angry_pixel.vx) < NOT_MOVING_THRESHOLD && fixed_abs(angry_pixel.vy) < NOT_MOVING_THRESHOLD) {
+            // Speed is below the threshold -> didn't move
+
+            // Count the frames
+            not_moving_count++;
+            if (not_moving_count >= NOT_MOVING_TIMEOUT) {
+                // The pixel dies when not moving for some time
+
+                angry_pixel.alive = false;
+
+                settle_world();
+            }
+        } else {
+            // It did move, reset the counter
+            not_moving_count = 0;
+        }
+    }
+}
+
+static int draw_number(int start_x, int y, unsigned number) {
+    int number_ = number;
+
+    // Count digits
+    int digit_count = 0;
+    while (number_ > 0) {
+        digit_count++;
+        number_ /= 10;
+    }
+    // 0 gives digit_count = 0, but we'd like to print '0', which has one digit
+    if (digit_count == 0) {
+        digit_count = 1;
+    }
+
+    // All digits have the same width, plus a space between the digits
+    int w = digit_count * digit_bitmap_width + (digit_count - 1);
+
+    number_ = number;
+
+    int x = start_x + w;
+    for (int i = 0; i < digit_count; i++) {
+        uint8_t digit = number_ % 10;
+
+        // The bitmap is drawn left-aligned
+        x -= digit_bitmap_width;
+
+        // Draw the digits bitmap
+        canvas_bitmap(x, y, digit_bitmaps[digit], digit_bitmap_width, digit_bitmap_height);
+
+        // Add a space
+        x -= 1;
+
+        number_ /= 10;
+    }
+
+    // Return where the last digit ends, to ease layout calculation for the caller
+    return start_x + w;
+}
+
+// Where render() is between the last two physics updates, from 0 to FIXED_ONE
+static fixed_t render_alpha() {
+    return fixed_from_int(REFRESH_RATE + physics_lag) / REFRESH_RATE;
+}
+
+// A box or target with its bottom left corner at x/y (in pixels, y up)
+static void draw_grid_object(enum grid_cell_type type, int x, int y) {
+    if (type == GRID_CELL_BOX) {
+        canvas_rect_stroke(x, 15 - y, x + 2, 15 - (y + 2));
+    } else if (type == GRID_CELL_TARGET) {
+        canvas_circle_stroke(x + 1, 15 - (y + 1), 1);
+    }
+}
+
+// The grid and the slingshot, drawn into world_layer when they changed
+static void render_world_layer() {
+    uint8_t *frame = canvas_get_buffer();
+    canvas_set_buffer((uint8_t *) world_layer);
+    canvas_clear();
+
+    // Objects still falling are drawn by render(), not where they land
+    uint16_t landing[GRID_ROWS] = { 0 };
+    if (game_state == GAME_STATE_UPDATE_WORLD) {
+        for (int i = 0; i < fall_count; i++) {
+            landing[falls[i].to_row] |= 1 << falls[i].col;
+        }
+    }
+
+    for (int row = 0; row < GRID_ROWS; row++) {
+        int y = 3 * row;
+
+        // Neighbouring solid cells touch, each run of them is one rectangle
+        uint16_t solid = grid.solid[row];
+        while (solid != 0) {
+            int first = 0;
+            while (!(solid & (1 << first))) {
+                first++;
+            }
+            int last = first;
+            while (solid & (1 << (last + 1))) {
+                last++;
+            }
+            solid &= ~((2 << last) - (1 << first));
+
+            canvas_rect_fill(GRID_X + 3 * first, 15 - y, GRID_X + 3 * last + 2, 15 - (y + 2));
+        }
+
+        uint16_t box = grid.box[row] & ~landing[row], target = grid.target[row] & ~landing[row];
+        if ((box | target) == 0) {
+            continue;
+        }
+
+        for (int col = 0; col < GRID_COLS; col++) {
+            if (box & (1 << col)) {
+                draw_grid_object(GRID_CELL_BOX, GRID_X + 3 * col, y);
+            } else if (target & (1 << col)) {
+                draw_grid_object(GRID_CELL_TARGET, GRID_X + 3 * col, y);
+            }
+        }
+    }
+
+    // The slingshot stand, dimmed if the display can do that
+    canvas_set_intensity(SLINGSHOT_INTENSITY);
+    canvas_vline(START_X, 15 - START_Y, 15);
+    canvas_set_intensity(CANVAS_INTENSITY_MAX);
+
+    canvas_set_buffer(frame);
+    world_layer_dirty = false;
+}
+
+// Draws the WON or LOST screen onto a cleared canvas
+static void render_result_screen() {
+    if (game_state == GAME_STATE_WON) {
+        /*********************
+         * LVL X CLEARED!    *
+         *  · X           -> *
+         *********************/
+
+        // "LVL"
+        canvas_bitmap(2, 2, bitmap_lvl, bitmap_lvl_width, bitmap_lvl_height);
+
+        // Level number
+        int end_x = draw_number(15, 2, current_level);
+
+        // "CLEARED!"
+        canvas_bitmap(end_x + 2, 2, bitmap_cleared, bitmap_cleared_width, bitmap_cleared_height);
+
+        // The pixel 'icon'
+        canvas_pixel_set(3, 11);
+        // Number of pixels thrown
+        draw_number(6, 9, pixels_used);
+
+        // A 'next' arrow if there is another level
+        if (current_level < loader_level_count() - 1) {
+            canvas_bitmap(55, 7, bitmap_next, bitmap_next_width, bitmap_next_height);
+        }
+    } else if (game_state == GAME_STATE_LOST) {
+        /*********************
+         * FAILED!           *
+         *                <- *
+         *********************/
+
+        // "FAILED!"
+        canvas_bitmap(2, 2, bitmap_failed, bitmap_failed_width, bitmap_failed_height);
+
+        // A 'retry' arrow
+        canvas_bitmap(55, 7, bitmap_retry, bitmap_retry_width, bitmap_retry_height);
+    }
+}
+
+// Identifies what a result screen shows, 0 when the game isn't showing one
+static uint64_t screen_key() {
+    if (game_state != GAME_STATE_WON && game_state != GAME_STATE_LOST) {
+        return 0;
+    }
+    // Whether there is a next level can change while the screen is up, when the host's levels come in
+    bool last_level = current_level >= loader_level_count() - 1;
+    // 16 bits for the level, there can be that many with the host's levels
+    return (uint64_t) last_level << 40 | (uint64_t) game_state << 32 | (uint64_t) (uint16_t) current_level << 16 |
+        (uint16_t) pixels_used;
+}
+
+void game_render() {
+    uint64_t key = screen_key();
+    if (key != 0) {
+        // Result screens are drawn once into the cache, and copied from there until what they show changes
+        struct screen_cache_entry *entry = &screen_cache[game_state == GAME_STATE_WON ? 0 : 1];
+        if (entry->key != key) {
+            uint8_t *frame = canvas_get_buffer();
+            canvas_set_buffer((uint8_t *) entry->frame);
+            canvas_clear();
+            render_result_screen();
+            canvas_set_buffer(frame);
+            entry->key = key;
+        }
+        canvas_copy((const uint8_t *) entry->frame);
+        screen_shown = key;
+    } else {
+        screen_shown = 0;
+
+        // The parts that don't move are only drawn when they change, everything else goes on top every frame
+        if (world_layer_dirty) {
+            render_world_layer();
+        }
+        canvas_copy((const uint8_t *) world_layer);
+
+        if (game_state == GAME_STATE_UPDATE_WORLD) {
+            // Falling objects, on their way or where they landed
+            fixed_t offset = (fall_time - 1) * FALL_SPEED + fixed_mul(FALL_SPEED, render_alpha());
+            if (offset < 0) {
+                offset = 0;
+            }
+
+            for (int i = 0; i < fall_count; i++) {
+                const struct fall *fall = &falls[i];
+
+                fixed_t distance = fixed_from_int(3 * (fall->from_row - fall->to_row));
+                fixed_t y = fixed_from_int(3 * fall->from_row) - (offset < distance ? offset : distance);
+                draw_grid_object(fall->type, GRID_X + 3 * fall->col, fixed_to_int(y));
+            }
+        }
+
+        if (angry_pixel.alive) {
+            // Draw the angry pixel where it is at the time of the frame, between the last two updates
+            fixed_t alpha = render_alpha();
+            fixed_t x = angry_pixel.last_x + fixed_mul(angry_pixel.x - angry_pixel.last_x, alpha);
+            fixed_t y = angry_pixel.last_y + fixed_mul(angry_pixel.y - angry_pixel.last_y, alpha);
+            canvas_pixel_set(fixed_to_int(x), 15 - fixed_to_int(y));
+        }
+
+        if (game_state == GAME_STATE_AIM) {
+            // Draw the angry pixel in the slingshot
+            canvas_pixel_set(fixed_to_int(aim_x), 15 - fixed_to_int(aim_y));
+        }
+    }
+}
+
+void game_invalidate() {
+    world_layer_dirty = true;
+    screen_cache[0].key = 0;
+    screen_cache[1].key = 0;
+    screen_shown = 0;
+}
+
+void game_init() {
+    // 45 degrees
+    aim_angle = FIXED_ANGLE_TURN / 8;
+    aim_power = fixed_from_int(4);
+
+    load_level(0);
+}
+
+// Advances the game by one physics update
+static void update(uint32_t input, uint32_t pressed) {
+    if (input_start_timeout > 0) {
+        // Wait for some time after starting a level before accepting input
+        input_start_timeout--;
+    } else {
+        if (game_state == GAME_STATE_AIM) {
+            // Adjust angle
+            if (input & BUTTON_PIN_A_DOWN) {
+                aim_angle -= ANGLE_INPUT_SPEED;
+            } else if (input & BUTTON_PIN_A_UP) {
+                aim_angle += ANGLE_INPUT_SPEED;
+            }
+
+            // Adjust power
+            if (input & BUTTON_PIN_P_DOWN) {
+                aim_power -= POWER_INPUT_SPEED;
+            } else if (input & BUTTON_PIN_P_UP) {
+                aim_power += POWER_INPUT_SPEED;
+            }
+
+            // Calculate the pixels position
+            fixed_t aim_cos = fixed_cos(aim_angle);
+            fixed_t aim_sin = fixed_sin(aim_angle);
+            aim_x = fixed_from_int(START_X) - fixed_mul(aim_cos, aim_power);
+            aim_y = fixed_from_int(START_Y) - fixed_mul(aim_sin, aim_power);
+
+            // Throw it
+            if (pressed & BUTTON_PIN_THROW) {
+                fixed_t speed = fixed_mul(aim_power, AIM_POWER_FACTOR);
+                angry_pixel.x = fixed_from_int(START_X);
+                angry_pixel.y = fixed_from_int(START_Y);
+                angry_pixel.last_x = angry_pixel.x;
+                angry_pixel.last_y = angry_pixel.y;
+                angry_pixel.vx = fixed_mul(aim_cos, speed);
+                angry_pixel.vy = fixed_mul(aim_sin, speed);
+                angry_pixel.alive = true;
+
+                game_state = GAME_STATE_THROW;
+                pixels_used++;
+            }
+        } else if (game_state == GAME_STATE_WON) {
+            // Advance to the next level, if there is one
+            if (pressed & BUTTON_PIN_THROW) {
+                if (current_level < loader_level_count() - 1) {
+                    level_pending = current_level + 1;
+                }
+            }
+        } else if (game_state == GAME_STATE_LOST) {
+            // Retry the current level
+            if (pressed & BUTTON_PIN_THROW) {
+                level_pending = current_level;
+            }
+        }
+
+        // A level from the host may still be on its way, the result screen stays up until it's there
+        if (level_pending >= 0) {
+            load_level(level_pending);
+        }
+    }
+
+    // Only simulate physics when we're in the 'THROW' state
+    if (game_state == GAME_STATE_THROW) {
+        uint32_t start = hal_cycles();
+        update_physics();
+        uint32_t cycles = hal_cycles() - start;
+        PROFILE_RECORD(PROFILE_ZONE_PHYSICS, cycles);
+
+        stats.physics_steps++;
+        stats.physics_cycles += cycles;
+        if (cycles > stats.physics_cycles_max) {
+            stats.physics_cycles_max = cycles;
+        }
+    }
+
+    // Only update the world when we're in the 'UPDATE_WORLD' state
+    if (game_state == GAME_STATE_UPDATE_WORLD) {
+        PROFILE_BEGIN(PROFILE_ZONE_WORLD);
+        update_world();
+        PROFILE_END(PROFILE_ZONE_WORLD);
+    }
+}
+
+bool game_tick(uint32_t input, uint32_t pressed, uint32_t frames) {
+    physics_lag += frames * PHYSICS_RATE;
+    pressed_pending |= pressed;
+
+    uint32_t updates = 0;
+    while (physics_lag > 0) {
+        if (updates == PHYSICS_UPDATES_MAX) {
+            // Too far behind to catch up, give up on that time rather than falling further behind
+            int32_t dropped = (physics_lag + REFRESH_RATE - 1) / REFRESH_RATE;
+            stats.physics_updates_dropped += dropped;
+            physics_lag -= dropped * REFRESH_RATE;
+            break;
+        }
+
+        PROFILE_BEGIN(PROFILE_ZONE_UPDATE);
+        update(input, pressed_pending);
+        PROFILE_END(PROFILE_ZONE_UPDATE);
+        physics_lag -= REFRESH_RATE;
+        updates++;
+        // A press only happens once, however many updates it takes to catch up
+        pressed_pending = 0;
+    }
+
+    // Running late: the simulation has caught up, drawing can wait for the next frame
+    if (frames > 1) {
+        stats.frames_skipped++;
+        return false;
+    }
+
+    // A result screen that is already on the display stays there without drawing or flipping anything
+    uint64_t key = screen_key();
+    if (key != 0 && key == screen_shown) {
+        stats.frames_unchanged++;
+        return false;
+    }
+
+    PROFILE_BEGIN(PROFILE_ZONE_RENDER);
+    game_render();
+    PROFILE_END(PROFILE_ZONE_RENDER);
+    stats.frames_rendered++;
+
+    return true;
+}
+
+enum game_state game_get_state() {
+    return game_state;
+}
+
+int game_get_level() {
+    return current_level;
+}
+
+const struct game_stats *game_get_stats() {
+    return &stats;
+}
@@ -0,0 +1,50 @@
+#ifndef __GAME_H__
+#define __GAME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// How often game_tick() is called per second, the game plays the same at any rate
+#ifndef REFRESH_RATE
+#define REFRESH_RATE 30
+#endif
+
+enum game_state {
+    GAME_STATE_AIM,
+    GAME_STATE_THROW,
+    GAME_STATE_UPDATE_WORLD,
+    GAME_STATE_LOST,
+    GAME_STATE_WON
+};
+
+struct game_stats {
+    // Calls to the physics step, and the time they took in total and at most, in hal_cycles()
+    uint32_t physics_steps;
+    uint32_t physics_cycles;
+    uint32_t physics_cycles_max;
+    // Physics updates given up on because game_tick() fell too far behind
+    uint32_t physics_updates_dropped;
+
+    // Frames drawn, and frames not drawn because game_tick() was running late
+    uint32_t frames_rendered;
+    uint32_t frames_skipped;
+    // Frames not drawn because the result screen on the display hadn't changed
+    uint32_t frames_unchanged;
+};
+
+void game_init();
+// Advances the game by 'frames' frames (1 unless frames were missed) and renders it. 'input' are the buttons held
+// down and 'pressed' the ones pressed since the last tick, both combinations of BUTTON_PIN_*. Returns false if
+// rendering was skipped to catch up or because the frame on the display is still current, the canvas is left
+// alone then and needn't be flipped.
+bool game_tick(uint32_t input, uint32_t pressed, uint32_t frames);
+// Draws the current state onto the canvas again, game_tick() does this after updating
+void game_render();
+// Redraws the parts of the frame that are cached between frames on the next game_render()
+void game_invalidate();
+enum game_state game_get_state();
+// The index of the level being played
+int game_get_level();
+const struct game_stats *game_get_stats();
+
+#endif /* __GAME_H__ */
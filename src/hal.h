@@ -0,0 +1,188 @@
+#ifndef __HAL_H__
+#define __HAL_H__
+
+// Hardware abstraction layer
+// Everything that touches the board directly goes through here, so that the game and the display driver
+// can also be built for the host simulator (see sim/)
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef SIMULATOR
+
+// The simulator doesn't have TivaWare, so provide the pin masks the board definitions below are built from
+#define GPIO_PIN_0 0x00000001
+#define GPIO_PIN_1 0x00000002
+#define GPIO_PIN_2 0x00000004
+#define GPIO_PIN_3 0x00000008
+#define GPIO_PIN_4 0x00000010
+#define GPIO_PIN_5 0x00000020
+#define GPIO_PIN_6 0x00000040
+#define GPIO_PIN_7 0x00000080
+
+// hal_cycles() counts nanoseconds on the host
+#define HAL_CYCLES_PER_SECOND 1000000000
+
+#else
+
+#include <driverlib/sysctl.h>
+#include <driverlib/gpio.h>
+#include <inc/hw_types.h>
+#include <inc/hw_memmap.h>
+
+#define HAL_CYCLES_PER_SECOND 80000000
+
+#endif
+
+/*
+ * Board wiring
+ */
+
+#define BUTTONS_PORT_PERIPH SYSCTL_PERIPH_GPIOA
+#define BUTTONS_PORT_BASE GPIO_PORTA_BASE
+#define BUTTON_PIN_A_DOWN GPIO_PIN_2
+#define BUTTON_PIN_A_UP GPIO_PIN_3
+#define BUTTON_PIN_P_DOWN GPIO_PIN_4
+#define BUTTON_PIN_P_UP GPIO_PIN_5
+#define BUTTON_PIN_THROW GPIO_PIN_6
+#define BUTTON_PINS (BUTTON_PIN_A_DOWN | BUTTON_PIN_A_UP | BUTTON_PIN_P_DOWN | BUTTON_PIN_P_UP | BUTTON_PIN_THROW)
+#define BUTTONS_INT INT_GPIOA
+
+// How the lines are pushed out: bit-banged over GPIO, or by the SSI fed by the uDMA
+#define DISPLAY_BACKEND_GPIO 0
+#define DISPLAY_BACKEND_SSI 1
+#ifndef DISPLAY_BACKEND
+#define DISPLAY_BACKEND DISPLAY_BACKEND_GPIO
+#endif
+
+#define DISPLAY_PORT_PERIPH SYSCTL_PERIPH_GPIOB
+#define DISPLAY_PORT_BASE GPIO_PORTB_AHB_BASE
+
+#define DISPLAY_PIN_DATA GPIO_PIN_0
+#define DISPLAY_PIN_SHIFT GPIO_PIN_1
+#define DISPLAY_PIN_LATCH GPIO_PIN_2
+#define DISPLAY_PIN_ENABLE GPIO_PIN_3
+#define DISPLAY_PIN_LINE_A GPIO_PIN_4
+#define DISPLAY_PIN_LINE_B GPIO_PIN_5
+#define DISPLAY_PIN_LINE_C GPIO_PIN_6
+#define DISPLAY_PIN_LINE_D GPIO_PIN_7
+#define DISPLAY_LINE_PINS (DISPLAY_PIN_LINE_A | DISPLAY_PIN_LINE_B | DISPLAY_PIN_LINE_C | DISPLAY_PIN_LINE_D)
+#define DISPLAY_PINS (\
+    DISPLAY_PIN_DATA | DISPLAY_PIN_SHIFT | DISPLAY_PIN_LATCH | DISPLAY_PIN_ENABLE | \
+    DISPLAY_LINE_PINS \
+)
+
+// With the SSI backend, 'DATA' is wired to SSI3Tx (PD3) and 'SHIFT' to SSI3Clk (PD0) instead of PB0/PB1
+#define DISPLAY_SSI_PERIPH SYSCTL_PERIPH_SSI3
+#define DISPLAY_SSI_BASE SSI3_BASE
+#define DISPLAY_SSI_INT INT_SSI3
+#define DISPLAY_SSI_PORT_PERIPH SYSCTL_PERIPH_GPIOD
+#define DISPLAY_SSI_PORT_BASE GPIO_PORTD_BASE
+#define DISPLAY_SSI_PIN_CLK GPIO_PIN_0
+#define DISPLAY_SSI_PIN_TX GPIO_PIN_3
+#define DISPLAY_SSI_DMA_CHANNEL 15
+#define DISPLAY_SSI_DMA_ASSIGN UDMA_CH15_SSI3TX
+// Bit rate of the SSI, this alone determines how fast the display is scanned
+#define DISPLAY_SSI_CLOCK 10000000
+
+// Telemetry goes out on UART0 (PA0/PA1), which the debugger's USB connection provides as a virtual serial port
+#define TELEMETRY_UART_PERIPH SYSCTL_PERIPH_UART0
+#define TELEMETRY_UART_BASE UART0_BASE
+#define TELEMETRY_UART_INT INT_UART0
+#define TELEMETRY_UART_PORT_PERIPH SYSCTL_PERIPH_GPIOA
+#define TELEMETRY_UART_PORT_BASE GPIO_PORTA_BASE
+#define TELEMETRY_UART_PIN_RX GPIO_PIN_0
+#define TELEMETRY_UART_PIN_TX GPIO_PIN_1
+#define TELEMETRY_UART_DMA_CHANNEL 9
+#define TELEMETRY_UART_DMA_ASSIGN UDMA_CH9_UART0TX
+// Levels come in on the same UART (see loader.h)
+#define TELEMETRY_UART_RX_DMA_CHANNEL 8
+#define TELEMETRY_UART_RX_DMA_ASSIGN UDMA_CH8_UART0RX
+// 8N1, so 10 bits on the wire per byte
+#define TELEMETRY_UART_BAUD 460800
+
+/*
+ * Interface
+ */
+
+// Clock setup etc., call this first
+void hal_init();
+
+void hal_display_init();
+// Calls 'slot' from interrupt context every 'period' hal_cycles(), at the highest priority
+void hal_scan_timer_init(uint32_t period, void (*slot)());
+// Sets the length of the slot after the one that is running
+void hal_scan_timer_next(uint32_t period);
+// Sets 'ENABLE' high (LEDs off) after 'cycles'
+void hal_display_blank_after(uint32_t cycles);
+// Sets the display pins in 'pins' to the corresponding bits of 'data'
+#ifdef SIMULATOR
+void hal_display_write(uint8_t pins, uint8_t data);
+#else
+// We use this macro for really fast GPIO access
+#define hal_display_write(pins, data) (HWREG(DISPLAY_PORT_BASE | (pins) << 2) = (data))
+#endif
+
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+// 'transfer_done' is called from interrupt context when the last bit of a transfer has been shifted out
+void hal_ssi_init(void (*transfer_done)());
+// Starts shifting out 'size' bytes, MSB first, 'data' has to stay valid until the transfer is done
+void hal_ssi_transfer(const uint8_t *data, uint32_t size);
+#endif
+
+// 'changed' is called from interrupt context on every edge of a button pin, 'settled' when the timer started by
+// hal_buttons_settle_after() runs out. Both at the same priority, below the display scan.
+void hal_buttons_init(void (*changed)(), void (*settled)());
+// (Re)starts the one-shot debounce timer
+void hal_buttons_settle_after(uint32_t cycles);
+// Returns the pressed buttons as a combination of BUTTON_PIN_*
+uint32_t hal_buttons_read();
+
+// 'transfer_done' is called from interrupt context once the uDMA has handed the last byte of a transfer to the UART
+void hal_uart_init(void (*transfer_done)());
+// Starts sending 'size' bytes, 'data' has to stay valid until the transfer is done
+void hal_uart_transfer(const uint8_t *data, uint32_t size);
+// Starts receiving on the UART set up by hal_uart_init(): the uDMA fills 'buffer0' and 'buffer1' by turns, 'size'
+// bytes each. 'received' gets each buffer that is full, from interrupt context. The buffer is filled again once
+// the other one is done, 'received' (or whoever it hands it to) has to be done with it by then.
+void hal_uart_receive_init(uint8_t *buffer0, uint8_t *buffer1, uint32_t size,
+    void (*received)(const uint8_t *data, uint32_t size));
+// Hands the buffer being filled to 'received' if anything is in it, and carries on with the other one
+void hal_uart_receive_flush();
+
+// Disables interrupts and returns whether they were disabled already, pass that to hal_interrupts_restore()
+bool hal_interrupts_disable();
+void hal_interrupts_restore(bool was_disabled);
+
+// Sleeps until the next interrupt
+void hal_wait_for_interrupt();
+
+// Reverses the order of the bits / bytes in a word (RBIT / REV on the Cortex-M4)
+#ifdef SIMULATOR
+static inline uint32_t hal_rbit(uint32_t x) {
+    x = (x >> 1 & 0x55555555) | (x & 0x55555555) << 1;
+    x = (x >> 2 & 0x33333333) | (x & 0x33333333) << 2;
+    x = (x >> 4 & 0x0f0f0f0f) | (x & 0x0f0f0f0f) << 4;
+    return x >> 24 | (x >> 8 & 0xff00) | (x & 0xff00) << 8 | x << 24;
+}
+static inline uint32_t hal_rev(uint32_t x) {
+    return x >> 24 | (x >> 8 & 0xff00) | (x & 0xff00) << 8 | x << 24;
+}
+#else
+#define hal_rbit(x) __rbit(x)
+#define hal_rev(x) __rev(x)
+#endif
+
+// Counts the leading zero bits of a word, 32 for 0 (CLZ on the Cortex-M4)
+#ifdef SIMULATOR
+static inline uint32_t hal_clz(uint32_t x) {
+    return x == 0 ? 32 : __builtin_clz(x);
+}
+#else
+#define hal_clz(x) __clz(x)
+#endif
+
+// Free-running counter, HAL_CYCLES_PER_SECOND ticks per second, wraps around
+uint32_t hal_cycles();
+
+#endif /* __HAL_H__ */
@@ -0,0 +1,345 @@
+#include "hal.h"
+
+#include <stdint.h>
+
+#include <driverlib/sysctl.h>
+#include <driverlib/gpio.h>
+#include <driverlib/interrupt.h>
+#include <driverlib/pin_map.h>
+#include <driverlib/ssi.h>
+#include <driverlib/timer.h>
+#include <driverlib/uart.h>
+#include <driverlib/udma.h>
+#include <inc/hw_types.h>
+#include <inc/hw_ints.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_gpio.h>
+#include <inc/hw_ssi.h>
+#include <inc/hw_uart.h>
+
+// Debug registers for the cycle counter (not covered by TivaWare)
+#define DEMCR 0xE000EDFC
+#define DEMCR_TRCENA 0x01000000
+#define DWT_CTRL 0xE0001000
+#define DWT_CTRL_CYCCNTENA 0x00000001
+#define DWT_CYCCNT 0xE0001004
+
+void hal_init() {
+    // Configure system clock to 80 MHz
+    SysCtlClockSet(SYSCTL_SYSDIV_2_5 | SYSCTL_USE_PLL | SYSCTL_XTAL_16MHZ | SYSCTL_OSC_MAIN);
+
+    // Start the DWT cycle counter
+    HWREG(DEMCR) |= DEMCR_TRCENA;
+    HWREG(DWT_CYCCNT) = 0;
+    HWREG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+}
+
+static void (*scan_timer_slot)();
+
+void hal_display_init() {
+    // Configure GPIO pins
+    SysCtlPeripheralEnable(DISPLAY_PORT_PERIPH);
+    // Access the GPIO registers over the AHB, for increased performance
+    SysCtlGPIOAHBEnable(DISPLAY_PORT_PERIPH);
+    GPIOPinTypeGPIOOutput(DISPLAY_PORT_BASE, DISPLAY_PINS);
+    hal_display_write(DISPLAY_PINS, 0x00);
+}
+
+void hal_scan_timer_init(uint32_t period, void (*slot)()) {
+    scan_timer_slot = slot;
+
+    // Timer 2 A turns the LEDs off at the end of a slot's 'ENABLE' window
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER2);
+    TimerConfigure(TIMER2_BASE, TIMER_CFG_ONE_SHOT);
+    TimerIntEnable(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+    TimerIntClear(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+    IntPrioritySet(INT_TIMER2A, 0x00);
+    IntEnable(INT_TIMER2A);
+
+    // Timer 1 A paces the display scan. It has the highest priority, so that nothing delays a line.
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER1);
+    TimerConfigure(TIMER1_BASE, TIMER_CFG_PERIODIC);
+    // A new load value only takes effect at the next timeout, so every slot can have its own length
+    TimerUpdateMode(TIMER1_BASE, TIMER_A, TIMER_UP_LOAD_TIMEOUT);
+    TimerLoadSet(TIMER1_BASE, TIMER_A, period);
+    TimerIntEnable(TIMER1_BASE, TIMER_TIMA_TIMEOUT);
+    TimerIntClear(TIMER1_BASE, TIMER_TIMA_TIMEOUT);
+    IntPrioritySet(INT_TIMER1A, 0x00);
+    IntEnable(INT_TIMER1A);
+    TimerEnable(TIMER1_BASE, TIMER_A);
+}
+
+void hal_scan_timer_next(uint32_t period) {
+    TimerLoadSet(TIMER1_BASE, TIMER_A, period);
+}
+
+void hal_display_blank_after(uint32_t cycles) {
+    TimerLoadSet(TIMER2_BASE, TIMER_A, cycles);
+    TimerEnable(TIMER2_BASE, TIMER_A);
+}
+
+void Timer1AIntHandler() {
+    TimerIntClear(TIMER1_BASE, TIMER_TIMA_TIMEOUT);
+
+    scan_timer_slot();
+}
+
+void Timer2AIntHandler() {
+    TimerIntClear(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+
+    hal_display_write(DISPLAY_PIN_ENABLE, DISPLAY_PIN_ENABLE);
+}
+
+// The uDMA channel control table has to be aligned to 1024 bytes
+#pragma DATA_ALIGN(dma_control_table, 1024)
+static uint8_t dma_control_table[1024];
+
+// Shared by the display SSI and the telemetry UART, whichever comes first sets it up
+static void dma_init() {
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+    initialized = true;
+
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    uDMAEnable();
+    uDMAControlBaseSet(dma_control_table);
+}
+
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+
+static void (*ssi_transfer_done)();
+// Whether the uDMA is still feeding the SSI FIFO
+static volatile bool ssi_dma_running;
+
+void hal_ssi_init(void (*transfer_done)()) {
+    ssi_transfer_done = transfer_done;
+
+    SysCtlPeripheralEnable(DISPLAY_SSI_PERIPH);
+    SysCtlPeripheralEnable(DISPLAY_SSI_PORT_PERIPH);
+
+    GPIOPinConfigure(GPIO_PD0_SSI3CLK);
+    GPIOPinConfigure(GPIO_PD3_SSI3TX);
+    GPIOPinTypeSSI(DISPLAY_SSI_PORT_BASE, DISPLAY_SSI_PIN_CLK | DISPLAY_SSI_PIN_TX);
+
+    // Mode 0: the clock idles low and the data is sampled on the rising edge, just like a pulse on 'SHIFT'
+    SSIConfigSetExpClk(DISPLAY_SSI_BASE, SysCtlClockGet(), SSI_FRF_MOTO_MODE_0, SSI_MODE_MASTER, DISPLAY_SSI_CLOCK, 8);
+    // End of transmission mode: the transmit interrupt fires once the last bit is out, not when the FIFO has room
+    HWREG(DISPLAY_SSI_BASE + SSI_O_CR1) |= SSI_CR1_EOT;
+    SSIEnable(DISPLAY_SSI_BASE);
+    SSIDMAEnable(DISPLAY_SSI_BASE, SSI_DMA_TX);
+
+    dma_init();
+    uDMAChannelAssign(DISPLAY_SSI_DMA_ASSIGN);
+    uDMAChannelAttributeDisable(DISPLAY_SSI_DMA_CHANNEL, UDMA_ATTR_ALL);
+    uDMAChannelControlSet(DISPLAY_SSI_DMA_CHANNEL | UDMA_PRI_SELECT,
+        UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+
+    IntPrioritySet(DISPLAY_SSI_INT, 0x00);
+    IntEnable(DISPLAY_SSI_INT);
+}
+
+void hal_ssi_transfer(const uint8_t *data, uint32_t size) {
+    ssi_dma_running = true;
+
+    uDMAChannelTransferSet(DISPLAY_SSI_DMA_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+        (void *) data, (void *) (DISPLAY_SSI_BASE + SSI_O_DR), size);
+    uDMAChannelEnable(DISPLAY_SSI_DMA_CHANNEL);
+}
+
+#endif
+
+void SSI3IntHandler() {
+#if DISPLAY_BACKEND == DISPLAY_BACKEND_SSI
+    if (ssi_dma_running) {
+        if (!uDMAChannelIsEnabled(DISPLAY_SSI_DMA_CHANNEL)) {
+            // The uDMA is done, but the FIFO is still being shifted out. Wait for the end of transmission.
+            ssi_dma_running = false;
+            uDMAIntClear(1 << DISPLAY_SSI_DMA_CHANNEL);
+            SSIIntEnable(DISPLAY_SSI_BASE, SSI_TXFF);
+        }
+    } else if (SSIIntStatus(DISPLAY_SSI_BASE, true) & SSI_TXFF) {
+        SSIIntDisable(DISPLAY_SSI_BASE, SSI_TXFF);
+        ssi_transfer_done();
+    }
+#endif
+}
+
+static void (*buttons_changed)();
+static void (*buttons_settled)();
+
+static void (*uart_transfer_done)();
+// Whether the uDMA is still feeding the UART FIFO
+static volatile bool uart_dma_running;
+
+static void (*uart_received)(const uint8_t *data, uint32_t size);
+static uint8_t *uart_receive_buffers[2];
+static uint32_t uart_receive_size;
+// The buffer the uDMA is filling
+static uint8_t uart_receive_index;
+
+void hal_uart_init(void (*transfer_done)()) {
+    uart_transfer_done = transfer_done;
+
+    SysCtlPeripheralEnable(TELEMETRY_UART_PERIPH);
+    SysCtlPeripheralEnable(TELEMETRY_UART_PORT_PERIPH);
+
+    GPIOPinConfigure(GPIO_PA0_U0RX);
+    GPIOPinConfigure(GPIO_PA1_U0TX);
+    GPIOPinTypeUART(TELEMETRY_UART_PORT_BASE, TELEMETRY_UART_PIN_RX | TELEMETRY_UART_PIN_TX);
+
+    UARTConfigSetExpClk(TELEMETRY_UART_BASE, SysCtlClockGet(), TELEMETRY_UART_BAUD,
+        UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE);
+    UARTFIFOEnable(TELEMETRY_UART_BASE);
+    UARTFIFOLevelSet(TELEMETRY_UART_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+    UARTDMAEnable(TELEMETRY_UART_BASE, UART_DMA_TX);
+
+    dma_init();
+    uDMAChannelAssign(TELEMETRY_UART_DMA_ASSIGN);
+    uDMAChannelAttributeDisable(TELEMETRY_UART_DMA_CHANNEL, UDMA_ATTR_ALL);
+    uDMAChannelControlSet(TELEMETRY_UART_DMA_CHANNEL | UDMA_PRI_SELECT,
+        UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+
+    // The UART interrupts when the uDMA is done with the transfer
+    UARTIntEnable(TELEMETRY_UART_BASE, UART_INT_DMATX);
+    IntPrioritySet(TELEMETRY_UART_INT, 0x40);
+    IntEnable(TELEMETRY_UART_INT);
+}
+
+void hal_uart_transfer(const uint8_t *data, uint32_t size) {
+    uart_dma_running = true;
+
+    uDMAChannelTransferSet(TELEMETRY_UART_DMA_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+        (void *) data, (void *) (TELEMETRY_UART_BASE + UART_O_DR), size);
+    uDMAChannelEnable(TELEMETRY_UART_DMA_CHANNEL);
+}
+
+static void uart_receive_start() {
+    uDMAChannelTransferSet(TELEMETRY_UART_RX_DMA_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+        (void *) (TELEMETRY_UART_BASE + UART_O_DR), uart_receive_buffers[uart_receive_index], uart_receive_size);
+    uDMAChannelEnable(TELEMETRY_UART_RX_DMA_CHANNEL);
+}
+
+// Hands over the first 'size' bytes of the buffer being filled and starts filling the other one. Whatever comes in
+// meanwhile waits in the receive FIFO.
+static void uart_receive_swap(uint32_t size) {
+    const uint8_t *data = uart_receive_buffers[uart_receive_index];
+    uart_receive_index ^= 1;
+    uart_receive_start();
+
+    uart_received(data, size);
+}
+
+void hal_uart_receive_init(uint8_t *buffer0, uint8_t *buffer1, uint32_t size,
+        void (*received)(const uint8_t *data, uint32_t size)) {
+    uart_received = received;
+    uart_receive_buffers[0] = buffer0;
+    uart_receive_buffers[1] = buffer1;
+    uart_receive_size = size;
+    uart_receive_index = 0;
+
+    uDMAChannelAssign(TELEMETRY_UART_RX_DMA_ASSIGN);
+    uDMAChannelAttributeDisable(TELEMETRY_UART_RX_DMA_CHANNEL, UDMA_ATTR_ALL);
+    // Byte by byte, the UART asks for a single transfer as soon as there is anything in the FIFO
+    uDMAChannelControlSet(TELEMETRY_UART_RX_DMA_CHANNEL | UDMA_PRI_SELECT,
+        UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_1);
+    uart_receive_start();
+
+    UARTDMAEnable(TELEMETRY_UART_BASE, UART_DMA_TX | UART_DMA_RX);
+    UARTIntEnable(TELEMETRY_UART_BASE, UART_INT_DMATX | UART_INT_DMARX);
+}
+
+void hal_uart_receive_flush() {
+    bool was_disabled = hal_interrupts_disable();
+
+    // Stop the uDMA where it is, with the rest of the transfer size left in the control table
+    uDMAChannelDisable(TELEMETRY_UART_RX_DMA_CHANNEL);
+    uint32_t size = uart_receive_size - uDMAChannelSizeGet(TELEMETRY_UART_RX_DMA_CHANNEL | UDMA_PRI_SELECT);
+    if (size > 0) {
+        uart_receive_swap(size);
+    } else {
+        uDMAChannelEnable(TELEMETRY_UART_RX_DMA_CHANNEL);
+    }
+
+    hal_interrupts_restore(was_disabled);
+}
+
+void UART0IntHandler() {
+    UARTIntClear(TELEMETRY_UART_BASE, UARTIntStatus(TELEMETRY_UART_BASE, true));
+
+    if (uart_dma_running && !uDMAChannelIsEnabled(TELEMETRY_UART_DMA_CHANNEL)) {
+        uart_dma_running = false;
+        uart_transfer_done();
+    }
+
+    if (uart_received != NULL && !uDMAChannelIsEnabled(TELEMETRY_UART_RX_DMA_CHANNEL)) {
+        uart_receive_swap(uart_receive_size);
+    }
+}
+
+void hal_buttons_init(void (*changed)(), void (*settled)()) {
+    buttons_changed = changed;
+    buttons_settled = settled;
+
+    // Configure the GPIO pins of the buttons
+    SysCtlPeripheralEnable(BUTTONS_PORT_PERIPH);
+    GPIOPinTypeGPIOInput(BUTTONS_PORT_BASE, BUTTON_PINS);
+    // Enable internal pull-ups
+    GPIOPadConfigSet(BUTTONS_PORT_BASE, BUTTON_PINS, GPIO_STRENGTH_2MA, GPIO_PIN_TYPE_STD_WPD);
+
+    // Timer 3 A is the debounce timer
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER3);
+    TimerConfigure(TIMER3_BASE, TIMER_CFG_ONE_SHOT);
+    TimerIntEnable(TIMER3_BASE, TIMER_TIMA_TIMEOUT);
+    TimerIntClear(TIMER3_BASE, TIMER_TIMA_TIMEOUT);
+    IntPrioritySet(INT_TIMER3A, 0x40);
+    IntEnable(INT_TIMER3A);
+
+    // Interrupt on both edges, presses as well as releases
+    GPIOIntTypeSet(BUTTONS_PORT_BASE, BUTTON_PINS, GPIO_BOTH_EDGES);
+    GPIOIntClear(BUTTONS_PORT_BASE, BUTTON_PINS);
+    GPIOIntEnable(BUTTONS_PORT_BASE, BUTTON_PINS);
+    IntPrioritySet(BUTTONS_INT, 0x40);
+    IntEnable(BUTTONS_INT);
+}
+
+void hal_buttons_settle_after(uint32_t cycles) {
+    TimerDisable(TIMER3_BASE, TIMER_A);
+    TimerLoadSet(TIMER3_BASE, TIMER_A, cycles);
+    TimerEnable(TIMER3_BASE, TIMER_A);
+}
+
+void GPIOAIntHandler() {
+    GPIOIntClear(BUTTONS_PORT_BASE, BUTTON_PINS);
+
+    buttons_changed();
+}
+
+void Timer3AIntHandler() {
+    TimerIntClear(TIMER3_BASE, TIMER_TIMA_TIMEOUT);
+
+    buttons_settled();
+}
+
+uint32_t hal_buttons_read() {
+    return GPIOPinRead(BUTTONS_PORT_BASE, BUTTON_PINS);
+}
+
+bool hal_interrupts_disable() {
+    return IntMasterDisable();
+}
+
+void hal_interrupts_restore(bool was_disabled) {
+    if (!was_disabled) {
+        IntMasterEnable();
+    }
+}
+
+void hal_wait_for_interrupt() {
+    SysCtlSleep();
+}
+
+uint32_t hal_cycles() {
+    return HWREG(DWT_CYCCNT);
+}
@@ -0,0 +1,87 @@
+
+#include "input.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hal.h"
+
+// Single producer (the button interrupts, which don't preempt each other) and single consumer (the main loop):
+// head is only written by the one and tail only by the other, so neither needs to disable interrupts.
+// Both count up and wrap around, the slot is the count modulo INPUT_QUEUE_SIZE.
+static volatile struct input_event input_queue[INPUT_QUEUE_SIZE];
+static volatile uint32_t input_queue_head;
+static volatile uint32_t input_queue_tail;
+
+// The buttons as of the last time they were read
+static uint32_t input_buttons;
+// Whether the pins are bouncing, and when that started
+static bool input_settling;
+static uint32_t input_edge_time;
+
+static struct input_stats stats;
+
+static void input_push(uint32_t time, uint32_t button, bool pressed) {
+    uint32_t head = input_queue_head;
+    if (head - input_queue_tail == INPUT_QUEUE_SIZE) {
+        stats.events_dropped++;
+        return;
+    }
+
+    volatile struct input_event *event = &input_queue[head % INPUT_QUEUE_SIZE];
+    event->time = time;
+    event->button = button;
+    event->pressed = pressed;
+    // Volatile accesses stay in order, so the event is complete before it's published
+    input_queue_head = head + 1;
+
+    stats.events++;
+}
+
+// Any edge on a button pin: wait for the pins to be quiet for INPUT_DEBOUNCE_CYCLES, every edge starts over
+static void input_changed() {
+    if (!input_settling) {
+        input_settling = true;
+        input_edge_time = hal_cycles();
+    }
+    hal_buttons_settle_after(INPUT_DEBOUNCE_CYCLES);
+}
+
+static void input_settled() {
+    input_settling = false;
+
+    uint32_t buttons = hal_buttons_read();
+    uint32_t changed = buttons ^ input_buttons;
+    input_buttons = buttons;
+
+    for (uint32_t button = 1; button <= BUTTON_PINS; button <<= 1) {
+        if (changed & button) {
+            input_push(input_edge_time, button, (buttons & button) != 0);
+        }
+    }
+}
+
+void input_init() {
+    hal_buttons_init(input_changed, input_settled);
+    input_buttons = hal_buttons_read();
+}
+
+bool input_next(struct input_event *event) {
+    uint32_t tail = input_queue_tail;
+    if (tail == input_queue_head) {
+        return false;
+    }
+
+    volatile struct input_event *queued = &input_queue[tail % INPUT_QUEUE_SIZE];
+    event->time = queued->time;
+    event->button = queued->button;
+    event->pressed = queued->pressed;
+    // Only hand the slot back once it has been read
+    input_queue_tail = tail + 1;
+
+    return true;
+}
+
+const struct input_stats *input_get_stats() {
+    return &stats;
+}
@@ -0,0 +1,38 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hal.h"
+
+// Button input: every edge on the button pins is debounced in interrupt context and queued as an event, the
+// main loop takes them out in order
+
+// How long the pins have to be quiet after an edge before they are read, in hal_cycles()
+#define INPUT_DEBOUNCE_CYCLES (HAL_CYCLES_PER_SECOND / 200)
+
+// Events that fit into the queue, a power of two
+#define INPUT_QUEUE_SIZE 16
+
+struct input_event {
+    // When the first edge of the change came in, in hal_cycles()
+    uint32_t time;
+    // One of BUTTON_PIN_*
+    uint32_t button;
+    bool pressed;
+};
+
+struct input_stats {
+    // Events queued, and events lost because the queue was full
+    uint32_t events;
+    uint32_t events_dropped;
+};
+
+// Sets up the buttons and their interrupts
+void input_init();
+// Takes the oldest event out of the queue, returns false if there is none
+bool input_next(struct input_event *event);
+const struct input_stats *input_get_stats();
+
+#endif /* __INPUT_H__ */
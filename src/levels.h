@@ -1,28 +1,50 @@
-
 #ifndef __LEVELS_H__
 #define __LEVELS_H__
 
 #include <stdlib.h>
+#include <stdint.h>
 
-enum level_object_type {
-    LEVEL_OBJECT_TYPE_END = 0,
-    LEVEL_OBJECT_TYPE_SOLID,
-    LEVEL_OBJECT_TYPE_BOX,
-    LEVEL_OBJECT_TYPE_TARGET
-};
+// Size of the world grid, in cells
+#define LEVEL_COLS 10
+#define LEVEL_ROWS 5
+
+// Bytes per bit-plane, one bit per cell
+#define LEVEL_PLANE_SIZE ((LEVEL_COLS * LEVEL_ROWS + 7) / 8)
 
-struct level_object {
-    enum level_object_type type;
-    size_t col;
-    size_t row;
+// What a cell holds, 2 bits
+enum level_cell {
+    LEVEL_CELL_EMPTY = 0,
+    LEVEL_CELL_SOLID,
+    LEVEL_CELL_BOX,
+    LEVEL_CELL_TARGET
 };
 
+// A level, packed: bit 'row * LEVEL_COLS + col' of plane 0 is the low bit of the cell's enum level_cell, the
+// same bit of plane 1 the high bit. Row 0 is the bottom one. Generated from the ASCII files in levels/ by
+// sim/levelc.c, see there for their format.
 struct level {
-    int pixels;
-    const struct level_object *objects;
+    uint8_t pixels;
+    uint8_t planes[2][LEVEL_PLANE_SIZE];
 };
 
 extern const struct level levels[];
 extern const size_t level_count;
 
+// Unpacks 'level' into one bitmask per cell type and row, bit 'col' being set if the cell holds that type
+static inline void level_unpack(const struct level *level, uint16_t solid[LEVEL_ROWS], uint16_t box[LEVEL_ROWS],
+        uint16_t target[LEVEL_ROWS]) {
+    for (int row = 0; row < LEVEL_ROWS; row++) {
+        // A row is LEVEL_COLS bits and spans at most two bytes of each plane
+        int bit = row * LEVEL_COLS;
+        int byte = bit / 8;
+        uint16_t mask = (1 << LEVEL_COLS) - 1;
+        uint16_t low = ((level->planes[0][byte] | level->planes[0][byte + 1] << 8) >> (bit % 8)) & mask;
+        uint16_t high = ((level->planes[1][byte] | level->planes[1][byte + 1] << 8) >> (bit % 8)) & mask;
+
+        solid[row] = low & ~high;
+        box[row] = high & ~low;
+        target[row] = low & high;
+    }
+}
+
 #endif /* __LEVELS_H__ */
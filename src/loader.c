@@ -0,0 +1,221 @@
+
+#include "loader.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "hal.h"
+#include "levels.h"
+#include "telemetry.h"
+
+struct cache_entry {
+    bool valid;
+    int index;
+    // loader_time when the level was last used or received, the smallest is evicted first
+    uint32_t used;
+    struct level level;
+};
+
+// The uDMA fills one buffer while the main loop reads the other
+static uint8_t loader_buffers[2][LOADER_BUFFER_SIZE];
+
+// Buffers handed over by the UART interrupt, single producer / single consumer like the input queue
+static const uint8_t *volatile received_data[2];
+static volatile uint32_t received_size[2];
+static volatile uint32_t received_head;
+static volatile uint32_t received_tail;
+
+// The packet being put together from the bytes received, it can span buffers
+static uint8_t packet[LOADER_PACKET_SIZE];
+static uint32_t packet_length;
+
+static struct cache_entry cache[LOADER_CACHE_SIZE];
+// Counts frames, for the LRU order and request timeouts
+static uint32_t loader_time;
+
+// The level asked for last and not received yet (-1 if none), and when it was asked for
+static int request_index = -1;
+static uint32_t request_time;
+// The level to prefetch, asked for as soon as nothing else is (-1 if none)
+static int prefetch_index = -1;
+
+// The number of levels the host has, 0 until it has answered
+static int host_level_count;
+
+static bool enabled;
+
+static struct loader_stats stats;
+
+static void received(const uint8_t *data, uint32_t size) {
+    uint32_t head = received_head;
+    if (head - received_tail == 2) {
+        // The main loop is two buffers behind, the older one is being overwritten already: the CRC sorts that out
+        return;
+    }
+
+    received_data[head % 2] = data;
+    received_size[head % 2] = size;
+    received_head = head + 1;
+}
+
+static struct cache_entry *cache_find(int index) {
+    for (int i = 0; i < LOADER_CACHE_SIZE; i++) {
+        if (cache[i].valid && cache[i].index == index) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void cache_put(int index, const struct level *level) {
+    struct cache_entry *entry = cache_find(index);
+    if (entry == NULL) {
+        // A free entry, or the least recently used one
+        entry = &cache[0];
+        for (int i = 1; i < LOADER_CACHE_SIZE && entry->valid; i++) {
+            if (!cache[i].valid || cache[i].used < entry->used) {
+                entry = &cache[i];
+            }
+        }
+        if (entry->valid) {
+            stats.evictions++;
+        }
+    }
+
+    entry->valid = true;
+    entry->index = index;
+    entry->used = loader_time;
+    entry->level = *level;
+}
+
+static void request(int index) {
+    if (telemetry_level_request(index)) {
+        stats.requests++;
+    }
+    // Asked for again after LOADER_REQUEST_TIMEOUT either way, the request might have been dropped or lost
+    request_index = index;
+    request_time = loader_time;
+}
+
+// Returns false if the packet is damaged
+static bool packet_received() {
+    uint16_t crc = packet[LOADER_PACKET_SIZE - 2] | packet[LOADER_PACKET_SIZE - 1] << 8;
+    if (packet[1] != LOADER_PACKET_LEVEL || loader_crc(packet + 1, LOADER_PACKET_SIZE - 3) != crc) {
+        stats.packets_damaged++;
+        return false;
+    }
+    stats.packets++;
+
+    int index = packet[2] | packet[3] << 8;
+    host_level_count = packet[4] | packet[5] << 8;
+
+    struct level level;
+    level.pixels = packet[6];
+    memcpy(level.planes, packet + 7, sizeof(level.planes));
+    cache_put(index, &level);
+
+    if (index == request_index) {
+        request_index = -1;
+    }
+    return true;
+}
+
+// Feeds one received byte into the packet being put together
+static void receive_byte(uint8_t byte) {
+    if (packet_length == 0 && byte != LOADER_SYNC) {
+        // Between packets, or after a damaged one until the next sync byte
+        return;
+    }
+
+    packet[packet_length++] = byte;
+    if (packet_length < LOADER_PACKET_SIZE) {
+        return;
+    }
+
+    packet_length = 0;
+    if (!packet_received()) {
+        // The sync byte was a data byte or the packet got cut short: the next packet may start in what was taken
+        // for this one
+        for (uint32_t i = 1; i < LOADER_PACKET_SIZE; i++) {
+            if (packet[i] == LOADER_SYNC) {
+                packet_length = LOADER_PACKET_SIZE - i;
+                memmove(packet, packet + i, packet_length);
+                break;
+            }
+        }
+    }
+}
+
+void loader_init() {
+    hal_uart_receive_init(loader_buffers[0], loader_buffers[1], LOADER_BUFFER_SIZE, received);
+    enabled = true;
+}
+
+void loader_poll() {
+    if (!enabled) {
+        return;
+    }
+    loader_time++;
+
+    // Whatever came in since the last frame, even if it doesn't fill a buffer
+    hal_uart_receive_flush();
+
+    uint32_t tail;
+    while ((tail = received_tail) != received_head) {
+        const uint8_t *data = received_data[tail % 2];
+        uint32_t size = received_size[tail % 2];
+        for (uint32_t i = 0; i < size; i++) {
+            receive_byte(data[i]);
+        }
+        received_tail = tail + 1;
+    }
+
+    // One request at a time, the one the game is waiting for comes first
+    if (request_index >= 0) {
+        if (loader_time - request_time >= LOADER_REQUEST_TIMEOUT) {
+            request(request_index);
+        }
+    } else if (prefetch_index >= 0) {
+        if (cache_find(prefetch_index) == NULL) {
+            request(prefetch_index);
+        }
+        prefetch_index = -1;
+    }
+}
+
+const struct level *loader_level(int index) {
+    struct cache_entry *entry = cache_find(index);
+    if (entry != NULL) {
+        stats.cache_hits++;
+        entry->used = loader_time;
+        return &entry->level;
+    }
+
+    if (host_level_count == 0) {
+        // No host, or it hasn't answered yet
+        return index < (int) level_count ? &levels[index] : NULL;
+    }
+
+    if (request_index != index) {
+        stats.cache_misses++;
+        request(index);
+    }
+    return NULL;
+}
+
+void loader_prefetch(int index) {
+    if (!enabled || index >= loader_level_count() || cache_find(index) != NULL) {
+        return;
+    }
+    prefetch_index = index;
+}
+
+int loader_level_count() {
+    return host_level_count > 0 ? host_level_count : (int) level_count;
+}
+
+const struct loader_stats *loader_get_stats() {
+    return &stats;
+}
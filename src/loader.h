@@ -0,0 +1,70 @@
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "levels.h"
+
+// Level loader: levels sent by a host over the telemetry UART, while the game runs. The game asks for a level with
+// a TELEMETRY_PACKET_LEVEL_REQUEST (see telemetry.h), the host answers with a level packet; levels that came in
+// are kept in a small LRU cache. A level from the host takes the place of the built-in one with the same index,
+// and once the host has answered, its level count replaces the built-in one.
+//
+// Level packet: LOADER_SYNC, LOADER_PACKET_LEVEL, level index (2 bytes), number of levels the host has (2 bytes),
+// the struct level (pixels, then the planes), CRC-16/CCITT (initial value 0xffff) of everything after the sync
+// byte (2 bytes). Values are little-endian.
+
+#define LOADER_SYNC 0x5a
+
+#define LOADER_PACKET_LEVEL 1
+
+#define LOADER_PACKET_SIZE (1 + 1 + 2 + 2 + 1 + 2 * LEVEL_PLANE_SIZE + 2)
+
+// Levels kept in RAM: the one being played, the next one and a few to go back to
+#define LOADER_CACHE_SIZE 4
+
+// Size of each of the two receive buffers; the host only sends what was asked for, at most a few packets at once
+#define LOADER_BUFFER_SIZE 64
+
+// A level asked for and not received by then is asked for again, in frames
+#define LOADER_REQUEST_TIMEOUT 15
+
+struct loader_stats {
+    // Level packets received, and packets or bytes skipped because they were damaged
+    uint32_t packets;
+    uint32_t packets_damaged;
+    // Requests sent, including repeated ones
+    uint32_t requests;
+    // Levels taken from the cache, and levels that weren't there when the game needed them
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    // Levels thrown out of the cache to make room
+    uint32_t evictions;
+};
+
+// Starts receiving, without this the game only plays the built-in levels
+void loader_init();
+// Takes in what was received since the last call and repeats requests that went unanswered, once per frame
+void loader_poll();
+// Returns level 'index', or NULL if it has to come from the host and isn't there yet (it is asked for then)
+const struct level *loader_level(int index);
+// Asks the host for level 'index' unless it is cached already, so that it is there by the time it is needed
+void loader_prefetch(int index);
+// The number of levels there are: the host's if it has answered, the built-in ones' otherwise
+int loader_level_count();
+const struct loader_stats *loader_get_stats();
+
+// CRC-16/CCITT, for building and checking level packets
+static inline uint16_t loader_crc(const uint8_t *data, uint32_t size) {
+    uint16_t crc = 0xffff;
+    for (uint32_t i = 0; i < size; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+#endif /* __LOADER_H__ */
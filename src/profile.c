@@ -0,0 +1,122 @@
+
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "hal.h"
+
+static const char *const zone_names[PROFILE_ZONE_COUNT] = {
+    [PROFILE_ZONE_FRAME] = "frame",
+    [PROFILE_ZONE_UPDATE] = "update",
+    [PROFILE_ZONE_PHYSICS] = "update_physics",
+    [PROFILE_ZONE_WORLD] = "update_world",
+    [PROFILE_ZONE_RENDER] = "render",
+    [PROFILE_ZONE_BITMAP] = "canvas_bitmap",
+    [PROFILE_ZONE_FLIP] = "display_flip",
+    [PROFILE_ZONE_SCAN_ROW] = "display_scan_row",
+};
+
+static struct profile_zone_stats zones[PROFILE_ZONE_COUNT];
+
+static struct profile_sample trace[PROFILE_TRACE_SIZE];
+// Samples recorded in total, the next one goes to trace_count % PROFILE_TRACE_SIZE
+static uint32_t trace_count;
+
+void profile_record(enum profile_zone zone, uint32_t cycles) {
+    // The scan records from its interrupt, so keep it out while a sample goes in
+    bool was_disabled = hal_interrupts_disable();
+
+    struct profile_zone_stats *stats = &zones[zone];
+    if (stats->count == 0 || cycles < stats->cycles_min) {
+        stats->cycles_min = cycles;
+    }
+    if (cycles > stats->cycles_max) {
+        stats->cycles_max = cycles;
+    }
+    stats->count++;
+    stats->cycles += cycles;
+
+    uint32_t bucket = 31 - hal_clz(cycles | 1);
+    if (bucket >= PROFILE_BUCKETS) {
+        bucket = PROFILE_BUCKETS - 1;
+    }
+    stats->buckets[bucket]++;
+
+    struct profile_sample *sample = &trace[trace_count % PROFILE_TRACE_SIZE];
+    sample->cycles = cycles;
+    sample->zone = zone;
+    trace_count++;
+
+    hal_interrupts_restore(was_disabled);
+}
+
+void profile_reset() {
+    bool was_disabled = hal_interrupts_disable();
+
+    for (int i = 0; i < PROFILE_ZONE_COUNT; i++) {
+        zones[i] = (struct profile_zone_stats) { 0 };
+    }
+    trace_count = 0;
+
+    hal_interrupts_restore(was_disabled);
+}
+
+const struct profile_zone_stats *profile_get_stats(enum profile_zone zone) {
+    return &zones[zone];
+}
+
+uint32_t profile_get_trace(struct profile_sample *samples, uint32_t count) {
+    bool was_disabled = hal_interrupts_disable();
+
+    uint32_t available = trace_count < PROFILE_TRACE_SIZE ? trace_count : PROFILE_TRACE_SIZE;
+    if (count > available) {
+        count = available;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        samples[i] = trace[(trace_count - count + i) % PROFILE_TRACE_SIZE];
+    }
+
+    hal_interrupts_restore(was_disabled);
+
+    return count;
+}
+
+void profile_dump(void (*write_line)(const char *line)) {
+    char line[128];
+
+    snprintf(line, sizeof(line), "%-17s %8s %10s %10s %10s", "zone", "count", "min", "avg", "max");
+    write_line(line);
+
+    for (int i = 0; i < PROFILE_ZONE_COUNT; i++) {
+        const struct profile_zone_stats *stats = &zones[i];
+        if (stats->count == 0) {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "%-17s %8lu %10lu %10lu %10lu", zone_names[i], (unsigned long) stats->count,
+            (unsigned long) stats->cycles_min, (unsigned long) (stats->cycles / stats->count),
+            (unsigned long) stats->cycles_max);
+        write_line(line);
+
+        // The histogram, as '<lower bound>:<count>' for the buckets that aren't empty
+        int length = snprintf(line, sizeof(line), "%17s", "");
+        for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+            if (stats->buckets[bucket] == 0) {
+                continue;
+            }
+            if (length > (int) sizeof(line) - 24) {
+                write_line(line);
+                length = snprintf(line, sizeof(line), "%17s", "");
+            }
+            length += snprintf(line + length, sizeof(line) - length, " %lu:%lu",
+                (unsigned long) 1 << bucket, (unsigned long) stats->buckets[bucket]);
+        }
+        write_line(line);
+    }
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+
+#include "hal.h"
+
+// Profiler: time spent in the zones below, in hal_cycles() (DWT cycles on the board, nanoseconds on the host)
+// Built in only if PROFILE is defined ('make PROFILE=1' for the simulator), otherwise all of it compiles to nothing.
+// Zones that can be interrupted include the time spent in the interrupts.
+
+enum profile_zone {
+    PROFILE_ZONE_FRAME,
+    PROFILE_ZONE_UPDATE,
+    PROFILE_ZONE_PHYSICS,
+    PROFILE_ZONE_WORLD,
+    PROFILE_ZONE_RENDER,
+    PROFILE_ZONE_BITMAP,
+    PROFILE_ZONE_FLIP,
+    PROFILE_ZONE_SCAN_ROW,
+    PROFILE_ZONE_COUNT
+};
+
+// Bucket i of the histograms counts the samples from 2^i to 2^(i+1) - 1 cycles, the last one everything above
+#define PROFILE_BUCKETS 24
+// The most recent samples are kept in a ring buffer, a power of two
+#define PROFILE_TRACE_SIZE 128
+
+struct profile_zone_stats {
+    uint32_t count;
+    uint64_t cycles;
+    uint32_t cycles_min;
+    uint32_t cycles_max;
+    uint32_t buckets[PROFILE_BUCKETS];
+};
+
+struct profile_sample {
+    uint32_t cycles;
+    uint8_t zone;
+};
+
+#ifdef PROFILE
+
+// Measures from PROFILE_BEGIN() to PROFILE_END() of the same zone, in the same block
+#define PROFILE_BEGIN(zone) uint32_t profile_start_##zone = hal_cycles()
+#define PROFILE_END(zone) profile_record(zone, hal_cycles() - profile_start_##zone)
+// For code that measures its time anyway
+#define PROFILE_RECORD(zone, cycles) profile_record(zone, cycles)
+
+void profile_record(enum profile_zone zone, uint32_t cycles);
+void profile_reset();
+const struct profile_zone_stats *profile_get_stats(enum profile_zone zone);
+// Copies the last 'count' samples (or as many as there are) to 'samples', oldest first, returns how many
+uint32_t profile_get_trace(struct profile_sample *samples, uint32_t count);
+// Writes the statistics of all zones as text, line by line
+void profile_dump(void (*write_line)(const char *line));
+
+#else
+
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone) ((void) 0)
+#define PROFILE_RECORD(zone, cycles) ((void) 0)
+
+#define profile_reset() ((void) 0)
+#define profile_dump(write_line) ((void) (write_line))
+
+#endif
+
+#endif /* __PROFILE_H__ */
@@ -0,0 +1,260 @@
+
+#include "telemetry.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "hal.h"
+#include "canvas.h"
+#include "display.h"
+#include "game.h"
+#include "frame.h"
+#include "input.h"
+#include "profile.h"
+
+// One buffer is filled while the uDMA sends the other
+static uint8_t telemetry_buffers[2][TELEMETRY_BUFFER_SIZE];
+static uint8_t fill_index;
+static uint32_t fill_length;
+static volatile bool sending;
+
+// Where the packet being written starts in the fill buffer, and whether it ran out of space
+static uint32_t packet_start;
+static bool packet_overflow;
+
+// The last frame sent, what the next one is XORed with
+static uint8_t reference_frame[CANVAS_BUFFER_SIZE];
+static uint32_t frames_since_key;
+
+static bool enabled;
+static int last_state = -1;
+static uint32_t frames_since_counters;
+
+static struct telemetry_stats stats;
+
+static void transfer_done() {
+    sending = false;
+}
+
+static void packet_begin(uint8_t type) {
+    packet_start = fill_length;
+    packet_overflow = false;
+
+    uint8_t *buffer = telemetry_buffers[fill_index];
+    // Room for the header and the checksum
+    if (fill_length + 5 > TELEMETRY_BUFFER_SIZE) {
+        packet_overflow = true;
+        return;
+    }
+    buffer[fill_length++] = TELEMETRY_SYNC;
+    buffer[fill_length++] = type;
+    // The length is filled in by packet_end()
+    fill_length += 2;
+}
+
+static void packet_put(uint8_t byte) {
+    // Keep a byte for the checksum
+    if (packet_overflow || fill_length + 1 >= TELEMETRY_BUFFER_SIZE) {
+        packet_overflow = true;
+        return;
+    }
+    telemetry_buffers[fill_index][fill_length++] = byte;
+}
+
+static void packet_put32(uint32_t value) {
+    packet_put(value);
+    packet_put(value >> 8);
+    packet_put(value >> 16);
+    packet_put(value >> 24);
+}
+
+// Returns false if the packet didn't fit, it's gone then
+static bool packet_end() {
+    if (packet_overflow) {
+        fill_length = packet_start;
+        return false;
+    }
+
+    uint8_t *buffer = telemetry_buffers[fill_index];
+    uint32_t length = fill_length - packet_start - 4;
+    buffer[packet_start + 2] = length;
+    buffer[packet_start + 3] = length >> 8;
+
+    uint8_t checksum = 0;
+    for (uint32_t i = packet_start + 1; i < fill_length; i++) {
+        checksum += buffer[i];
+    }
+    buffer[fill_length++] = checksum;
+
+    return true;
+}
+
+// What goes out for byte 'i' of the frame
+static inline uint8_t frame_delta(const uint8_t *frame, bool key, uint32_t i) {
+    return key ? frame[i] : frame[i] ^ reference_frame[i];
+}
+
+static void send_frame(const uint8_t *frame) {
+    bool key = frames_since_key == 0;
+
+    packet_begin(TELEMETRY_PACKET_FRAME);
+    packet_put(key ? TELEMETRY_FRAME_KEY : 0);
+    packet_put(CANVAS_BPP);
+
+    uint32_t i = 0;
+    while (i < CANVAS_BUFFER_SIZE && !packet_overflow) {
+        uint32_t run = 0;
+        if (frame_delta(frame, key, i) == 0) {
+            // A run of unchanged bytes
+            while (i + run < CANVAS_BUFFER_SIZE && run < 128 && frame_delta(frame, key, i + run) == 0) {
+                run++;
+            }
+            packet_put(0x7f + run);
+        } else {
+            // Changed bytes, up to the next unchanged one
+            while (i + run < CANVAS_BUFFER_SIZE && run < 128 && frame_delta(frame, key, i + run) != 0) {
+                run++;
+            }
+            packet_put(run - 1);
+            for (uint32_t j = 0; j < run; j++) {
+                packet_put(frame_delta(frame, key, i + j));
+            }
+        }
+        i += run;
+    }
+
+    if (!packet_end()) {
+        // The decoder never sees it, so the next one has to be XORed with the same frame as this one
+        stats.frames_dropped++;
+        return;
+    }
+
+    memcpy(reference_frame, frame, CANVAS_BUFFER_SIZE);
+    stats.frames_sent++;
+    frames_since_key = (frames_since_key + 1) % TELEMETRY_KEY_FRAME_INTERVAL;
+}
+
+static bool send_state(int state) {
+    packet_begin(TELEMETRY_PACKET_STATE);
+    packet_put(state);
+    int level = game_get_level();
+    packet_put(level);
+    packet_put(level >> 8);
+    if (!packet_end()) {
+        stats.packets_dropped++;
+        return false;
+    }
+    return true;
+}
+
+static void send_counters() {
+    const struct frame_stats *frame_stats = frame_get_stats();
+    const struct game_stats *game_stats = game_get_stats();
+    const struct display_stats *display_stats = display_get_stats();
+    const struct input_stats *input_stats = input_get_stats();
+
+    uint32_t counters[TELEMETRY_COUNTER_COUNT] = {
+        [TELEMETRY_COUNTER_FRAMES_RUN] = frame_stats->frames_run,
+        [TELEMETRY_COUNTER_DEADLINE_MISSES] = frame_stats->deadline_misses,
+        [TELEMETRY_COUNTER_FRAME_CYCLES_MAX] = frame_stats->frame_cycles_max,
+        [TELEMETRY_COUNTER_FRAMES_RENDERED] = game_stats->frames_rendered,
+        [TELEMETRY_COUNTER_FRAMES_SKIPPED] = game_stats->frames_skipped,
+        [TELEMETRY_COUNTER_FRAMES_UNCHANGED] = game_stats->frames_unchanged,
+        [TELEMETRY_COUNTER_PHYSICS_UPDATES_DROPPED] = game_stats->physics_updates_dropped,
+        [TELEMETRY_COUNTER_FRAMES_FLIPPED] = display_stats->frames_flipped,
+        [TELEMETRY_COUNTER_FRAMES_SHOWN] = display_stats->frames_shown,
+        [TELEMETRY_COUNTER_FRAMES_DROPPED] = display_stats->frames_dropped,
+        [TELEMETRY_COUNTER_ROWS_ENCODED] = display_stats->rows_encoded,
+        [TELEMETRY_COUNTER_ROWS_MISSED] = display_stats->rows_missed,
+        [TELEMETRY_COUNTER_INPUT_EVENTS] = input_stats->events,
+        [TELEMETRY_COUNTER_INPUT_EVENTS_DROPPED] = input_stats->events_dropped,
+        [TELEMETRY_COUNTER_PRESS_LATENCY_CYCLES_MAX] = frame_stats->press_latency_cycles_max,
+        [TELEMETRY_COUNTER_TELEMETRY_FRAMES_SENT] = stats.frames_sent,
+        [TELEMETRY_COUNTER_TELEMETRY_FRAMES_DROPPED] = stats.frames_dropped,
+        [TELEMETRY_COUNTER_TELEMETRY_PACKETS_DROPPED] = stats.packets_dropped,
+        [TELEMETRY_COUNTER_TELEMETRY_BYTES_SENT] = stats.bytes_sent,
+    };
+
+    packet_begin(TELEMETRY_PACKET_COUNTERS);
+    for (int i = 0; i < TELEMETRY_COUNTER_COUNT; i++) {
+        packet_put32(counters[i]);
+    }
+    if (!packet_end()) {
+        stats.packets_dropped++;
+    }
+
+#ifdef PROFILE
+    packet_begin(TELEMETRY_PACKET_PROFILE);
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        const struct profile_zone_stats *zone_stats = profile_get_stats(zone);
+        if (zone_stats->count == 0) {
+            continue;
+        }
+        packet_put(zone);
+        packet_put32(zone_stats->count);
+        packet_put32(zone_stats->cycles_min);
+        packet_put32(zone_stats->cycles / zone_stats->count);
+        packet_put32(zone_stats->cycles_max);
+    }
+    if (!packet_end()) {
+        stats.packets_dropped++;
+    }
+#endif
+}
+
+void telemetry_init() {
+    hal_uart_init(transfer_done);
+    enabled = true;
+}
+
+void telemetry_frame(const uint8_t *frame) {
+    if (!enabled) {
+        return;
+    }
+
+    // Tried again next frame if it doesn't fit
+    int state = game_get_state();
+    if (state != last_state && send_state(state)) {
+        last_state = state;
+    }
+
+    if (frame != NULL) {
+        send_frame(frame);
+    }
+
+    if (++frames_since_counters == REFRESH_RATE) {
+        send_counters();
+        frames_since_counters = 0;
+    }
+
+    // Send what there is unless the uDMA is still busy with the last buffer, then it waits for the next frame
+    if (!sending && fill_length > 0) {
+        sending = true;
+        hal_uart_transfer(telemetry_buffers[fill_index], fill_length);
+        stats.bytes_sent += fill_length;
+
+        fill_index ^= 1;
+        fill_length = 0;
+    }
+}
+
+bool telemetry_level_request(int index) {
+    if (!enabled) {
+        return false;
+    }
+
+    packet_begin(TELEMETRY_PACKET_LEVEL_REQUEST);
+    packet_put(index);
+    packet_put(index >> 8);
+    if (!packet_end()) {
+        stats.packets_dropped++;
+        return false;
+    }
+    return true;
+}
+
+const struct telemetry_stats *telemetry_get_stats() {
+    return &stats;
+}
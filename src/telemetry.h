@@ -0,0 +1,81 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Telemetry: a stream of packets on the UART, sent by the uDMA so that the game never waits for it. Packets
+// that don't fit into the buffer being filled are dropped (and counted), the buffer goes out at the end of
+// the frame if the previous one is done by then.
+//
+// Packet: TELEMETRY_SYNC, type, payload length (2 bytes), payload, checksum (the sum of all bytes from the type
+// on, modulo 256). Values are little-endian.
+//
+// TELEMETRY_PACKET_FRAME: flags (TELEMETRY_FRAME_KEY), bits per pixel, then the canvas buffer XORed with the
+//   previous frame sent (nothing for key frames), run-length encoded: a control byte c below 0x80 is followed by
+//   c + 1 literal bytes, one from 0x80 on stands for c - 0x7f zero bytes
+// TELEMETRY_PACKET_STATE: game state, level (2 bytes), whenever the state changes
+// TELEMETRY_PACKET_COUNTERS: TELEMETRY_COUNTER_COUNT counters (4 bytes each), once a second
+// TELEMETRY_PACKET_PROFILE: zone, count, min, average and max (1 + 4 * 4 bytes) per zone with samples, once a
+//   second if the profiler is built in (see profile.h)
+// TELEMETRY_PACKET_LEVEL_REQUEST: level index (2 bytes), for the host to answer with the level (see loader.h)
+
+#define TELEMETRY_SYNC 0xa5
+
+#define TELEMETRY_PACKET_FRAME 1
+#define TELEMETRY_PACKET_STATE 2
+#define TELEMETRY_PACKET_COUNTERS 3
+#define TELEMETRY_PACKET_PROFILE 4
+#define TELEMETRY_PACKET_LEVEL_REQUEST 5
+
+#define TELEMETRY_FRAME_KEY 0x01
+
+// Every this many frames sent, one is sent whole, so that a decoder can pick up the stream
+#define TELEMETRY_KEY_FRAME_INTERVAL 30
+
+// Size of each of the two transmit buffers; at TELEMETRY_UART_BAUD one takes 22 ms to send
+#define TELEMETRY_BUFFER_SIZE 1024
+
+enum telemetry_counter {
+    TELEMETRY_COUNTER_FRAMES_RUN,
+    TELEMETRY_COUNTER_DEADLINE_MISSES,
+    TELEMETRY_COUNTER_FRAME_CYCLES_MAX,
+    TELEMETRY_COUNTER_FRAMES_RENDERED,
+    TELEMETRY_COUNTER_FRAMES_SKIPPED,
+    TELEMETRY_COUNTER_FRAMES_UNCHANGED,
+    TELEMETRY_COUNTER_PHYSICS_UPDATES_DROPPED,
+    TELEMETRY_COUNTER_FRAMES_FLIPPED,
+    TELEMETRY_COUNTER_FRAMES_SHOWN,
+    TELEMETRY_COUNTER_FRAMES_DROPPED,
+    TELEMETRY_COUNTER_ROWS_ENCODED,
+    TELEMETRY_COUNTER_ROWS_MISSED,
+    TELEMETRY_COUNTER_INPUT_EVENTS,
+    TELEMETRY_COUNTER_INPUT_EVENTS_DROPPED,
+    TELEMETRY_COUNTER_PRESS_LATENCY_CYCLES_MAX,
+    TELEMETRY_COUNTER_TELEMETRY_FRAMES_SENT,
+    TELEMETRY_COUNTER_TELEMETRY_FRAMES_DROPPED,
+    TELEMETRY_COUNTER_TELEMETRY_PACKETS_DROPPED,
+    TELEMETRY_COUNTER_TELEMETRY_BYTES_SENT,
+    TELEMETRY_COUNTER_COUNT
+};
+
+struct telemetry_stats {
+    // Frames sent, and frames dropped because they didn't fit into the buffer
+    uint32_t frames_sent;
+    uint32_t frames_dropped;
+    // Other packets dropped for the same reason
+    uint32_t packets_dropped;
+    // Bytes handed to the UART
+    uint32_t bytes_sent;
+};
+
+// Sets up the UART, nothing is sent before
+void telemetry_init();
+// Called once per frame, with the frame about to be flipped or NULL if there is none
+void telemetry_frame(const uint8_t *frame);
+// Asks the host for level 'index', it goes out at the end of the frame. Returns false if it didn't fit or
+// telemetry isn't running.
+bool telemetry_level_request(int index);
+const struct telemetry_stats *telemetry_get_stats();
+
+#endif /* __TELEMETRY_H__ */